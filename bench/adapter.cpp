@@ -0,0 +1,121 @@
+// Microbenchmark: conversion of Steam Deck's HID frames into DSU motion data.
+// Measures smoothing of accelerometer axis, conversion of a frame (CemuhookAdapter::SetMotionData)
+// and the whole step of the adapter without reader (SetMotionDataFromFrame),
+// with consecutive frames and with every other frame missing (replication of missed frames).
+
+#include "sdgyrodsu/cemuhookadapter.h"
+#include "sdgyrodsu/sdhidframe.h"
+#include "harness.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace kmicki::sdgyrodsu;
+using namespace kmicki::cemuhook::protocol;
+using namespace kmicki::bench;
+
+static const int cFrameLen = 64;
+static const int cFrames = 256;         // frames in a buffer (cycled, stays in cache)
+static const uint64_t cFramePeriodNs = 4000000;
+static const int16_t cAcc1G = 0x4000;
+
+// Frames of a controller lying on a table: noise of accelerometer and gyro,
+// with occasional large change of acceleration.
+static std::vector<frame_t> GenerateFrames()
+{
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> noise(-300,300);
+    std::vector<frame_t> frames(cFrames,frame_t(cFrameLen));
+    for(int i = 0; i < cFrames; ++i)
+    {
+        SdHidFrame sdFrame = {};
+        sdFrame.Header = 0x3C400109;
+        sdFrame.AccelAxisRightToLeft = noise(random);
+        sdFrame.AccelAxisFrontToBack = noise(random);
+        sdFrame.AccelAxisTopToBottom = cAcc1G + ((i % 32 == 0) ? 0x1000 : 0) + noise(random);
+        sdFrame.GyroAxisRightToLeft = noise(random)/10;
+        sdFrame.GyroAxisFrontToBack = noise(random)/10;
+        sdFrame.GyroAxisTopToBottom = noise(random)/10;
+        memcpy(frames[i].data(),&sdFrame,sizeof(sdFrame));
+    }
+    return frames;
+}
+
+static void RunSmoothAccel(Harness & harness, std::vector<frame_t> const& frames)
+{
+    std::vector<int16_t> samples;
+    for(auto const& frame : frames)
+        samples.push_back(GetSdFrame(frame).AccelAxisTopToBottom);
+
+    harness.Run("adapter/smooth_accel",[&](uint64_t iterations)
+    {
+        float last = 0.0f;
+        float sum = 0.0f;
+        for(uint64_t i = 0; i < iterations; ++i)
+            sum += SmoothAccel(last,samples[i%cFrames]);
+        DoNotOptimize(sum);
+    },"sample");
+}
+
+static void RunSetMotionData(Harness & harness, std::vector<frame_t> const& frames)
+{
+    harness.Run("adapter/set_motion_data",[&](uint64_t iterations)
+    {
+        MotionData motion = {};
+        float lastAccelRtL = 0.0f, lastAccelFtB = 0.0f, lastAccelTtB = 0.0f;
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            CemuhookAdapter::SetMotionData(GetSdFrame(frames[i%cFrames]),motion,lastAccelRtL,lastAccelFtB,lastAccelTtB);
+            DoNotOptimize(motion);
+        }
+    },"frame");
+}
+
+// step: difference of increments of consecutive frames (frames in between are replicated)
+static void RunFromFrame(Harness & harness, char const* name, std::vector<frame_t> frames, uint32_t step)
+{
+    static const size_t cIncrementPos = offsetof(SdHidFrame,Increment);
+
+    CemuhookAdapter adapter;
+
+    harness.Run(name,[&](uint64_t iterations)
+    {
+        MotionData motion = {};
+        uint32_t increment = 1;
+        uint64_t timestamp = 1000000000;
+        adapter.StartFrameGrab();
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            auto & frame = frames[i%cFrames];
+            memcpy(frame.data()+cIncrementPos,&increment,sizeof(increment));
+            frame.Timestamp = timestamp;
+            increment += step;
+            timestamp += step*cFramePeriodNs;
+
+            adapter.SetMotionDataFromFrame(frame,motion);
+            while(adapter.GetToReplicate() > 0)
+                adapter.SetMotionDataReplicated(motion);
+            DoNotOptimize(motion);
+        }
+        adapter.StopFrameGrab();
+    },"frame");
+}
+
+int main()
+{
+    printf("Conversion of %d-byte HID frames into motion data\n",cFrameLen);
+
+    auto frames = GenerateFrames();
+
+    Harness harness("adapter");
+    RunSmoothAccel(harness,frames);
+    RunSetMotionData(harness,frames);
+    RunFromFrame(harness,"adapter/from_frame",frames,1);
+    RunFromFrame(harness,"adapter/from_frame_replicated",frames,2);
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Microbenchmark: CRC-32 of DSU packets.
+// Checks that all implementations (and patching of id) give the same CRC as the bitwise one,
+// then compares the bitwise loop with table-driven and hardware-accelerated kernels
+// and full recalculation with patching for a packet sent to multiple clients.
+
+#include "cemuhook/crc32.h"
+#include "cemuhook/cemuhookprotocol.h"
+#include "harness.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace kmicki::cemuhook;
+using namespace kmicki::cemuhook::protocol;
+using namespace kmicki::bench;
+
+static const int cPacketLen = sizeof(DataEvent);
+static const int cPackets = 256;        // packets in a buffer (cycled, stays in cache)
+static const size_t cIdOffset = offsetof(DataEvent,header)+offsetof(Header,id);
+
+typedef uint32_t (*Crc32Fn)(void const*, size_t, uint32_t);
+
+static bool Check(char const* name, Crc32Fn crc32, std::vector<char> const& data)
+{
+    static const char cCheckString[] = "123456789";
+    static const uint32_t cCheckValue = 0xCBF43926;
+
+    if(crc32(cCheckString,sizeof(cCheckString)-1,0) != cCheckValue)
+    {
+        printf("%s: wrong CRC of check string\n",name);
+        return false;
+    }
+
+    // every length and alignment up to a few blocks, continued calculation
+    for(size_t offset = 0; offset < 16; ++offset)
+        for(size_t len = 0; len + offset <= 300; ++len)
+        {
+            auto expected = kernel::Crc32Bitwise(data.data()+offset,len);
+            if(crc32(data.data()+offset,len,0) != expected)
+            {
+                printf("%s: wrong CRC (offset %zu, length %zu)\n",name,offset,len);
+                return false;
+            }
+            auto split = len/3;
+            if(crc32(data.data()+offset+split,len-split,crc32(data.data()+offset,split,0)) != expected)
+            {
+                printf("%s: wrong continued CRC (offset %zu, length %zu)\n",name,offset,len);
+                return false;
+            }
+        }
+    return true;
+}
+
+static bool CheckPatch(std::vector<char> packet)
+{
+    Crc32Patch patch(cPacketLen,cIdOffset);
+    std::mt19937 random(1);
+
+    uint32_t id = 0;
+    memcpy(packet.data()+cIdOffset,&id,sizeof(id));
+    auto crc = kernel::Crc32Bitwise(packet.data(),cPacketLen);
+    for(int i = 0; i < 10000; ++i)
+    {
+        uint32_t newId = random();
+        crc = patch(crc,id,newId);
+        id = newId;
+        memcpy(packet.data()+cIdOffset,&id,sizeof(id));
+        if(crc != kernel::Crc32Bitwise(packet.data(),cPacketLen))
+        {
+            printf("patch: wrong CRC for id %08x\n",id);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Run(Harness & harness, char const* name, Crc32Fn crc32, std::vector<char> const& packets)
+{
+    harness.Run(std::string("crc32/")+name,[&](uint64_t iterations)
+    {
+        uint32_t checksum = 0;
+        for(uint64_t i = 0; i < iterations; ++i)
+            checksum += crc32(packets.data()+(i%cPackets)*cPacketLen,cPacketLen,0);
+        DoNotOptimize(checksum);
+    },"packet");
+}
+
+static void RunPatch(Harness & harness)
+{
+    Crc32Patch patch(cPacketLen,cIdOffset);
+
+    harness.Run("crc32/id_patch",[&](uint64_t iterations)
+    {
+        uint32_t checksum = 0;
+        for(uint64_t i = 0; i < iterations; ++i)
+            checksum += patch(i,0,i*2654435761u);
+        DoNotOptimize(checksum);
+    },"packet");
+}
+
+int main()
+{
+    std::vector<char> packets(cPackets*cPacketLen);
+    for(size_t i = 0; i < packets.size(); ++i)
+        packets[i] = (char)(i*131+7);
+
+    printf("CRC-32 of %d-byte DSU data packet, selected kernel: %s\n",cPacketLen,GetCrc32KernelName());
+
+    bool ok = Check("slice8",kernel::Crc32Slice8,packets);
+#if defined(__x86_64__) || defined(__i386__)
+    if(kernel::IsPclmulSupported())
+        ok = Check("pclmul",kernel::Crc32Pclmul,packets) && ok;
+#endif
+#if defined(__aarch64__)
+    if(kernel::IsArmv8CrcSupported())
+        ok = Check("armv8",kernel::Crc32Armv8,packets) && ok;
+#endif
+    ok = Check("selected",Crc32,packets) && ok;
+    ok = CheckPatch(std::vector<char>(packets.begin(),packets.begin()+cPacketLen)) && ok;
+    if(!ok)
+        return 1;
+    printf("All implementations match the bitwise one.\n");
+
+    Harness harness("crc32");
+    Run(harness,"bitwise",kernel::Crc32Bitwise,packets);
+    Run(harness,"slice8",kernel::Crc32Slice8,packets);
+#if defined(__x86_64__) || defined(__i386__)
+    if(kernel::IsPclmulSupported())
+        Run(harness,"pclmul",kernel::Crc32Pclmul,packets);
+#endif
+#if defined(__aarch64__)
+    if(kernel::IsArmv8CrcSupported())
+        Run(harness,"armv8",kernel::Crc32Armv8,packets);
+#endif
+    Run(harness,"selected",Crc32,packets);
+    RunPatch(harness);
+
+    return 0;
+}
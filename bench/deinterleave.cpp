@@ -0,0 +1,81 @@
+// Microbenchmark: extraction of HID frame from hiddev records.
+// Compares the per-byte loop with vectorized kernels.
+// Also measures the check of frame start with comparison of start marker.
+
+#include "hiddev/hiddevrecords.h"
+#include "harness.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace kmicki::hiddev;
+using namespace kmicki::bench;
+
+static const int cFrameLen = 64;
+static const int cFrames = 256;         // frames in a buffer (cycled, stays in cache)
+static const int cMarkerLen = 4;        // length of start marker of Steam Deck's frame
+
+typedef void (*ExtractFn)(char const*, char*, size_t);
+
+static void Run(Harness & harness, char const* name, ExtractFn extract, std::vector<char> const& records)
+{
+    std::vector<char> frame(cFrameLen);
+
+    harness.Run(std::string("deinterleave/")+name,[&](uint64_t iterations)
+    {
+        unsigned checksum = 0;
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            extract(records.data()+(i%cFrames)*cFrameLen*cRecordLen,frame.data(),cFrameLen);
+            checksum += (unsigned char)frame[i%cFrameLen];
+        }
+        DoNotOptimize(checksum);
+    },"frame");
+}
+
+// Check of frame start done on every frame read from hiddev file.
+static void RunFrameStart(Harness & harness, std::vector<char> const& records)
+{
+    // frames starting with alternative usage code, so that start marker is compared
+    std::vector<char> frames(records);
+    std::vector<char> marker(cMarkerLen);
+    for(int i = 0; i < cFrames; ++i)
+    {
+        uint32_t usage = 0xFFFF0001;
+        memcpy(frames.data()+i*cFrameLen*cRecordLen,&usage,sizeof(usage));
+    }
+    for(int i = 0; i < cMarkerLen; ++i)
+        marker[i] = frames[i*cRecordLen+cRecordBytePos];
+
+    harness.Run("deinterleave/frame_start",[&](uint64_t iterations)
+    {
+        unsigned count = 0;
+        for(uint64_t i = 0; i < iterations; ++i)
+            count += IsRecordsFrameStart(frames.data(),marker.data(),marker.size());
+        DoNotOptimize(count);
+    },"frame");
+}
+
+int main()
+{
+    std::vector<char> records(cFrames*cFrameLen*cRecordLen);
+    for(size_t i = 0; i < records.size(); ++i)
+        records[i] = (char)(i*131+7);
+
+    printf("hiddev record extraction, %d-byte frame, selected kernel: %s\n",cFrameLen,GetRecordKernelName());
+
+    Harness harness("deinterleave");
+    Run(harness,"scalar",kernel::ExtractRecordBytesScalar,records);
+#if defined(__x86_64__) || defined(__i386__)
+    Run(harness,"sse2",kernel::ExtractRecordBytesSse2,records);
+    if(kernel::IsAvx2Supported())
+        Run(harness,"avx2",kernel::ExtractRecordBytesAvx2,records);
+#endif
+    Run(harness,"selected",ExtractRecordBytes,records);
+    RunFrameStart(harness,records);
+
+    return 0;
+}
@@ -0,0 +1,504 @@
+// DSU client swarm: load generator and latency benchmark of a running server.
+// Opens a UDP socket per simulated client, runs version/info/data request handshake,
+// re-subscribes periodically (as DSU clients do) and verifies magic, length, CRC and id of every packet.
+// Reports per-client packet inter-arrival jitter, lost packets (gaps in packet numbers) and totals.
+// Run the server with a synthetic or replayed HID source (SDGYRO_SYNTHETIC, SDGYRO_REPLAY) for repeatable load.
+//
+// Usage: dsuswarm [-c clients] [-d seconds] [-H address] [-p port] [-s slot] [-r resubscribe_ms] [-v]
+//     -c: number of simulated clients (default 1)
+//     -d: duration of the measurement in seconds (default 10)
+//     -H: IPv4 address of the server (default 127.0.0.1)
+//     -p: port of the server (default SDGYRO_SERVER_PORT or 26760)
+//     -s: slot to subscribe to, -1 - all slots (default -1)
+//     -r: period of re-subscription in ms (default 1000)
+//     -v: report of each client
+
+#include "cemuhook/cemuhookprotocol.h"
+#include "cemuhook/crc32.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace kmicki::cemuhook;
+using namespace kmicki::cemuhook::protocol;
+
+static const uint16_t cProtocolVersion = 1001;
+static const uint32_t cVersionType = 0x100000;
+static const uint32_t cInfoType = 0x100001;
+static const uint32_t cDataType = 0x100002;
+static const int cSlotCount = 4;
+static const int cRecvBatch = 32;
+static const int cMaxPacketLen = 256;
+static const int cDefaultPort = 26760;
+static const int cSocketBufferBytes = 256*1024;
+static const uint64_t cRequestSpacingNs = 200000;  // between requests of consecutive clients (burst would overflow server's socket)
+
+static volatile sig_atomic_t interrupted = 0;
+
+static uint64_t NowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);     // same clock as SO_TIMESTAMPNS
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+// Packet numbers and arrival times of data of one slot.
+struct SlotState
+{
+    bool started = false;
+    uint32_t lastPacket = 0;
+    uint64_t lastArrivalNs = 0;
+};
+
+struct Client
+{
+    int fd = -1;
+    uint32_t id = 0;
+    uint32_t serverId = 0;
+    bool serverIdKnown = false;
+
+    uint64_t subscribedNs = 0;
+    uint64_t firstDataNs = 0;
+
+    uint64_t versionAnswers = 0;
+    uint64_t infoAnswers = 0;
+    uint64_t packets = 0;
+    uint64_t badMagic = 0;
+    uint64_t badLength = 0;
+    uint64_t badCrc = 0;
+    uint64_t badId = 0;
+    uint64_t gaps = 0;
+    uint64_t lost = 0;
+    uint64_t reordered = 0;
+
+    std::array<SlotState,cSlotCount> slots;
+    std::vector<uint32_t> interArrivalUs;   // between consecutive data packets of a slot
+};
+
+// Request with valid length and CRC.
+template<class T>
+static void FillRequest(T & request, uint32_t const& clientId, uint32_t const& eventType)
+{
+    auto & header = *reinterpret_cast<Header*>(&request);
+    memcpy(header.magic,"DSUC",4);
+    header.version = cProtocolVersion;
+    header.length = sizeof(T) - sizeof(Header) + sizeof(header.eventType);
+    header.crc32 = 0;
+    header.id = clientId;
+    header.eventType = eventType;
+    header.crc32 = Crc32(&request,sizeof(T));
+}
+
+struct VersionRequest
+{
+    Header header;
+};
+
+struct InfoRequestPacket
+{
+    Header header;
+    InfoRequest request;
+};
+
+// As on the wire (SubscribeRequest has padding).
+struct SubscribePacket
+{
+    Header header;
+    uint8_t mask;
+    uint8_t slot;
+    uint8_t mac[6];
+} __attribute__((packed));
+
+static void SendSubscribe(Client & client, int const& slot)
+{
+    SubscribePacket packet = {};
+    packet.mask = (slot < 0) ? 0 : 1;
+    packet.slot = (slot < 0) ? 0 : slot;
+    FillRequest(packet,client.id,cDataType);
+    send(client.fd,&packet,sizeof(packet),MSG_DONTWAIT);
+}
+
+static void SendHandshake(Client & client, int const& slot)
+{
+    VersionRequest version = {};
+    FillRequest(version,client.id,cVersionType);
+    send(client.fd,&version,sizeof(version),MSG_DONTWAIT);
+
+    InfoRequestPacket info = {};
+    info.request.portCnt = cSlotCount;
+    for(int i = 0; i < cSlotCount; ++i)
+        info.request.slots[i] = i;
+    FillRequest(info,client.id,cInfoType);
+    send(client.fd,&info,sizeof(info),MSG_DONTWAIT);
+
+    client.subscribedNs = NowNs();
+    SendSubscribe(client,slot);
+}
+
+// Verify a received packet and account it.
+static void HandlePacket(Client & client, char * data, int const& len, uint64_t const& arrivalNs)
+{
+    if(len < (int)sizeof(Header) || memcmp(data,"DSUS",4) != 0)
+    {
+        ++client.badMagic;
+        return;
+    }
+
+    // length doesn't include first 16 bytes of the header, padding after declared length is allowed
+    Header header;
+    memcpy(&header,data,sizeof(header));
+    if(header.length + sizeof(Header) - sizeof(header.eventType) > (size_t)len)
+    {
+        ++client.badLength;
+        return;
+    }
+
+    memset(data+offsetof(Header,crc32),0,sizeof(header.crc32));
+    if(Crc32(data,len) != header.crc32)
+    {
+        ++client.badCrc;
+        return;
+    }
+
+    // id of the server is constant among its run
+    if(client.serverIdKnown && header.id != client.serverId)
+        ++client.badId;
+    client.serverId = header.id;
+    client.serverIdKnown = true;
+
+    switch(header.eventType)
+    {
+        case cVersionType:
+            ++client.versionAnswers;
+            return;
+        case cInfoType:
+            ++client.infoAnswers;
+            return;
+        case cDataType:
+            break;
+        default:
+            return;
+    }
+
+    if(len != (int)sizeof(DataEvent))
+    {
+        ++client.badLength;
+        return;
+    }
+
+    DataEvent event;
+    memcpy(&event,data,sizeof(event));
+    if(event.response.slot >= cSlotCount)
+    {
+        ++client.badLength;
+        return;
+    }
+
+    ++client.packets;
+    if(client.firstDataNs == 0)
+        client.firstDataNs = arrivalNs;
+
+    auto & slot = client.slots[event.response.slot];
+    if(slot.started)
+    {
+        int64_t diff = (int64_t)event.packetNumber - (int64_t)slot.lastPacket;
+        if(diff > 1)
+        {
+            ++client.gaps;
+            client.lost += diff - 1;
+        }
+        else if(diff < 1)
+            ++client.reordered;
+        if(arrivalNs > slot.lastArrivalNs)
+            client.interArrivalUs.push_back((uint32_t)std::min<uint64_t>((arrivalNs - slot.lastArrivalNs)/1000,UINT32_MAX));
+    }
+    // packet numbering restarts when server stops sending the slot
+    if(!slot.started || event.packetNumber > slot.lastPacket || event.packetNumber <= 1)
+        slot.lastPacket = event.packetNumber;
+    slot.started = true;
+    slot.lastArrivalNs = arrivalNs;
+}
+
+// Receive all pending packets of a client.
+static void Receive(Client & client)
+{
+    static char buffers[cRecvBatch][cMaxPacketLen];
+    static char controls[cRecvBatch][CMSG_SPACE(sizeof(timespec))];
+    static iovec vecs[cRecvBatch];
+    static mmsghdr messages[cRecvBatch];
+
+    while(true)
+    {
+        for(int i = 0; i < cRecvBatch; ++i)
+        {
+            vecs[i].iov_base = buffers[i];
+            vecs[i].iov_len = cMaxPacketLen;
+            messages[i] = mmsghdr();
+            messages[i].msg_hdr.msg_iov = &vecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = controls[i];
+            messages[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+        }
+
+        auto count = recvmmsg(client.fd,messages,cRecvBatch,MSG_DONTWAIT,nullptr);
+        if(count <= 0)
+            return;
+
+        auto now = NowNs();
+        for(int i = 0; i < count; ++i)
+        {
+            // kernel arrival time, so that jitter of this process isn't measured
+            uint64_t arrivalNs = now;
+            for(auto cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&messages[i].msg_hdr,cmsg))
+                if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+                {
+                    timespec ts;
+                    memcpy(&ts,CMSG_DATA(cmsg),sizeof(ts));
+                    arrivalNs = (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+                }
+            HandlePacket(client,buffers[i],messages[i].msg_len,arrivalNs);
+        }
+
+        if(count < cRecvBatch)
+            return;
+    }
+}
+
+// Statistics of inter-arrival times.
+struct Jitter
+{
+    double mean = 0, stdev = 0;
+    uint32_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+
+    Jitter() = default;
+
+    Jitter(std::vector<uint32_t> samples)
+    {
+        if(samples.empty())
+            return;
+        double sum = 0, sumSq = 0;
+        for(auto s : samples)
+        {
+            sum += s;
+            sumSq += (double)s*s;
+        }
+        mean = sum/samples.size();
+        stdev = std::sqrt(std::max(0.0,sumSq/samples.size() - mean*mean));
+        std::sort(samples.begin(),samples.end());
+        auto at = [&](double fraction) { return samples[std::min(samples.size()-1,(size_t)(fraction*samples.size()))]; };
+        p50 = at(0.5);
+        p99 = at(0.99);
+        p999 = at(0.999);
+        max = samples.back();
+    }
+};
+
+static void PrintUsage(char const* name)
+{
+    printf("Usage: %s [-c clients] [-d seconds] [-H address] [-p port] [-s slot] [-r resubscribe_ms] [-v]\n",name);
+}
+
+static void OnSignal(int)
+{
+    interrupted = 1;
+}
+
+int main(int argc, char ** argv)
+{
+    int clientCount = 1;
+    double duration = 10.0;
+    char const* address = "127.0.0.1";
+    int port = cDefaultPort;
+    int slot = -1;
+    int resubscribeMs = 1000;
+    bool verbose = false;
+
+    if(char const* envPort = std::getenv("SDGYRO_SERVER_PORT"))
+        port = std::atoi(envPort);
+
+    int opt;
+    while((opt = getopt(argc,argv,"c:d:H:p:s:r:v")) != -1)
+    {
+        switch(opt)
+        {
+            case 'c': clientCount = std::atoi(optarg); break;
+            case 'd': duration = std::atof(optarg); break;
+            case 'H': address = optarg; break;
+            case 'p': port = std::atoi(optarg); break;
+            case 's': slot = std::atoi(optarg); break;
+            case 'r': resubscribeMs = std::atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default:
+                PrintUsage(argv[0]);
+                return 1;
+        }
+    }
+    if(clientCount <= 0 || duration <= 0 || resubscribeMs <= 0 || slot >= cSlotCount)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if(inet_pton(AF_INET,address,&server.sin_addr) != 1)
+    {
+        printf("Invalid server address: %s\n",address);
+        return 1;
+    }
+
+    signal(SIGINT,OnSignal);
+    signal(SIGTERM,OnSignal);
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> clients(clientCount);
+    uint32_t idBase = (uint32_t)getpid() << 12;
+    for(int i = 0; i < clientCount; ++i)
+    {
+        auto & client = clients[i];
+        client.id = idBase + i;
+        client.fd = socket(AF_INET,SOCK_DGRAM | SOCK_CLOEXEC,0);
+        if(client.fd < 0)
+        {
+            printf("Failed to create socket of client %d (raise open files limit?)\n",i);
+            return 1;
+        }
+        int enable = 1;
+        setsockopt(client.fd,SOL_SOCKET,SO_TIMESTAMPNS,&enable,sizeof(enable));
+        int bufferBytes = cSocketBufferBytes;
+        setsockopt(client.fd,SOL_SOCKET,SO_RCVBUF,&bufferBytes,sizeof(bufferBytes));
+        // only packets of the server are received
+        if(connect(client.fd,(sockaddr*)&server,sizeof(server)) < 0)
+        {
+            printf("Failed to connect socket of client %d\n",i);
+            return 1;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epollFd,EPOLL_CTL_ADD,client.fd,&event);
+    }
+
+    printf("DSU swarm: %d clients of %s:%d, slot %s, %.1f s, re-subscribe every %d ms\n",
+           clientCount,address,port,(slot < 0) ? "all" : std::to_string(slot).c_str(),duration,resubscribeMs);
+
+    auto start = NowNs();
+    auto end = start + (uint64_t)(duration*1e9);
+    std::vector<epoll_event> events(std::min(clientCount,256));
+
+    // Requests of clients are spread over the period: n-th request is of client n % clientCount
+    // in round n / clientCount (handshake in first round, re-subscription in the following ones).
+    uint64_t period = (uint64_t)resubscribeMs*1000000;
+    uint64_t spacing = std::min(cRequestSpacingNs,period/clientCount);
+    uint64_t request = 0;
+    auto requestTime = [&](uint64_t n) { return start + (n/clientCount)*period + (n%clientCount)*spacing; };
+
+    while(!interrupted)
+    {
+        auto now = NowNs();
+        if(now >= end)
+            break;
+        for(; requestTime(request) <= now; ++request)
+        {
+            auto & client = clients[request % clientCount];
+            if(request < (uint64_t)clientCount)
+                SendHandshake(client,slot);
+            else
+                SendSubscribe(client,slot);
+        }
+        auto timeoutMs = (int)((std::min(end,requestTime(request)) - now)/1000000) + 1;
+        auto count = epoll_wait(epollFd,events.data(),events.size(),timeoutMs);
+        for(int i = 0; i < count; ++i)
+            Receive(clients[events[i].data.u32]);
+    }
+    double elapsed = (NowNs() - start)/1e9;
+
+    for(auto & client : clients)
+        close(client.fd);
+    close(epollFd);
+
+    // Report
+    uint64_t packets = 0, badMagic = 0, badLength = 0, badCrc = 0, badId = 0, gaps = 0, lost = 0, reordered = 0;
+    uint64_t versionAnswers = 0, infoAnswers = 0;
+    int withData = 0;
+    double firstDataSum = 0, firstDataMax = 0;
+    double minRate = -1;
+    int worst = -1;
+    double worstStdev = -1;
+    std::vector<uint32_t> allInterArrival;
+
+    if(verbose)
+        printf("%6s %9s %9s %7s %6s %8s %8s %8s %8s %8s\n","client","packets","rate[Hz]","lost","bad","mean[us]","stdev","p99","p99.9","max");
+
+    for(int i = 0; i < clientCount; ++i)
+    {
+        auto const& client = clients[i];
+        auto bad = client.badMagic + client.badLength + client.badCrc + client.badId;
+        packets += client.packets;
+        badMagic += client.badMagic;
+        badLength += client.badLength;
+        badCrc += client.badCrc;
+        badId += client.badId;
+        gaps += client.gaps;
+        lost += client.lost;
+        reordered += client.reordered;
+        versionAnswers += client.versionAnswers;
+        infoAnswers += client.infoAnswers;
+
+        double rate = client.packets/elapsed;
+        if(minRate < 0 || rate < minRate)
+            minRate = rate;
+        if(client.firstDataNs != 0)
+        {
+            ++withData;
+            double firstMs = (client.firstDataNs - client.subscribedNs)/1e6;
+            firstDataSum += firstMs;
+            firstDataMax = std::max(firstDataMax,firstMs);
+        }
+
+        Jitter jitter(client.interArrivalUs);
+        if(jitter.stdev > worstStdev)
+        {
+            worstStdev = jitter.stdev;
+            worst = i;
+        }
+        if(verbose)
+            printf("%6d %9llu %9.1f %7llu %6llu %8.1f %8.1f %8u %8u %8u\n",i,(unsigned long long)client.packets,rate,
+                   (unsigned long long)client.lost,(unsigned long long)bad,jitter.mean,jitter.stdev,jitter.p99,jitter.p999,jitter.max);
+        allInterArrival.insert(allInterArrival.end(),client.interArrivalUs.begin(),client.interArrivalUs.end());
+    }
+
+    auto bad = badMagic + badLength + badCrc + badId;
+    printf("Measured %.2f s\n",elapsed);
+    printf("Handshake: version answers %llu/%d, info answers %llu/%d, clients with data %d/%d",
+           (unsigned long long)versionAnswers,clientCount,(unsigned long long)infoAnswers,clientCount*cSlotCount,withData,clientCount);
+    if(withData > 0)
+        printf(", first data after %.2f ms (max %.2f ms)",firstDataSum/withData,firstDataMax);
+    printf("\n");
+    printf("Data packets: %llu (%.1f Hz per client, min %.1f Hz), bad: %llu (magic %llu, length %llu, CRC %llu, id %llu)\n",
+           (unsigned long long)packets,packets/elapsed/clientCount,minRate,(unsigned long long)bad,
+           (unsigned long long)badMagic,(unsigned long long)badLength,(unsigned long long)badCrc,(unsigned long long)badId);
+    printf("Lost: %llu packets in %llu gaps (%.3f%%), reordered or repeated: %llu\n",
+           (unsigned long long)lost,(unsigned long long)gaps,(packets+lost > 0) ? 100.0*lost/(packets+lost) : 0.0,(unsigned long long)reordered);
+
+    Jitter total(allInterArrival);
+    printf("Inter-arrival [us]: mean %.1f stdev %.1f p50 %u p99 %u p99.9 %u max %u\n",total.mean,total.stdev,total.p50,total.p99,total.p999,total.max);
+    if(worst >= 0 && clientCount > 1 && worstStdev > 0)
+        printf("Highest jitter: client %d, stdev %.1f us\n",worst,worstStdev);
+
+    return (bad > 0 || packets == 0) ? 1 : 0;
+}
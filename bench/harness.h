@@ -0,0 +1,156 @@
+// Harness of microbenchmarks.
+// Each measurement is calibrated (number of iterations is increased until a run takes cMinRunNs)
+// and repeated cRepetitions times. Median and minimum time per operation are reported.
+// Results are printed and, if SDGYRO_BENCH_JSON is set, written into that file as JSON
+// (make bench writes them into $BINDIR/bench/results), so that runs of different commits can be compared.
+
+#ifndef _KMICKI_BENCH_HARNESS_H_
+#define _KMICKI_BENCH_HARNESS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kmicki::bench
+{
+    static const uint64_t cMinRunNs = 20000000;
+    static const int cRepetitions = 5;
+
+    // Keep value from being optimized away.
+    template<class T>
+    inline void DoNotOptimize(T const& value)
+    {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    class Harness
+    {
+        public:
+        struct Result
+        {
+            std::string name;
+            std::string unit;       // what one operation is
+            double nsPerOp;         // median of repetitions
+            double nsPerOpMin;
+            uint64_t iterations;    // iterations of single repetition
+            int repetitions;
+        };
+
+        // suite: name of the benchmark executable
+        Harness(std::string const& _suite)
+        : suite(_suite)
+        {
+            auto path = std::getenv("SDGYRO_BENCH_JSON");
+            if(path != nullptr)
+                jsonPath = path;
+            auto label = std::getenv("SDGYRO_BENCH_LABEL");
+            if(label != nullptr)
+                this->label = label;
+        }
+
+        // Write JSON results.
+        ~Harness()
+        {
+            if(!jsonPath.empty())
+                WriteJson();
+        }
+
+        // Measure fn(iterations) that performs given number of operations.
+        template<class F>
+        Result const& Run(std::string const& name, F && fn, char const* unit = "op")
+        {
+            // warm up and calibrate
+            uint64_t iterations = 1;
+            while(true)
+            {
+                auto ns = Measure(fn,iterations);
+                if(ns >= cMinRunNs)
+                    break;
+                auto factor = (ns > 0) ? (double)cMinRunNs*1.2/ns : 100.0;
+                iterations = (uint64_t)(iterations*std::clamp(factor,2.0,100.0));
+            }
+
+            std::vector<double> nsPerOp;
+            for(int i = 0; i < cRepetitions; ++i)
+                nsPerOp.push_back((double)Measure(fn,iterations)/iterations);
+            std::sort(nsPerOp.begin(),nsPerOp.end());
+
+            return Add({ name, unit, nsPerOp[cRepetitions/2], nsPerOp.front(), iterations, cRepetitions });
+        }
+
+        // Report result measured by the benchmark itself.
+        Result const& Report(std::string const& name, double nsPerOp, uint64_t iterations, char const* unit = "op")
+        {
+            return Add({ name, unit, nsPerOp, nsPerOp, iterations, 1 });
+        }
+
+        private:
+        std::string suite;
+        std::string label;
+        std::string jsonPath;
+        std::vector<Result> results;
+
+        template<class F>
+        static uint64_t Measure(F & fn, uint64_t iterations)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn(iterations);
+            auto end = std::chrono::steady_clock::now();
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+        }
+
+        Result const& Add(Result && result)
+        {
+            printf("%-32s %10.2f ns/%-8s (min %.2f, %llu x %d)\n",result.name.c_str(),result.nsPerOp,result.unit.c_str(),
+                   result.nsPerOpMin,(unsigned long long)result.iterations,result.repetitions);
+            results.push_back(std::move(result));
+            return results.back();
+        }
+
+        static std::string Quote(std::string const& text)
+        {
+            std::string quoted = "\"";
+            for(auto c : text)
+            {
+                if(c == '"' || c == '\\')
+                    quoted += '\\';
+                if((unsigned char)c >= 0x20)
+                    quoted += c;
+            }
+            return quoted + "\"";
+        }
+
+        void WriteJson()
+        {
+            std::ofstream out(jsonPath);
+            if(!out)
+            {
+                printf("Failed to write results into %s\n",jsonPath.c_str());
+                return;
+            }
+            out << "{\n  \"suite\": " << Quote(suite) << ",\n"
+                << "  \"label\": " << Quote(label) << ",\n"
+                << "  \"time\": " << (long long)std::time(nullptr) << ",\n"
+                << "  \"results\": [";
+            for(size_t i = 0; i < results.size(); ++i)
+            {
+                auto const& r = results[i];
+                char numbers[128];
+                snprintf(numbers,sizeof(numbers),"\"ns_per_op\": %.3f, \"ns_per_op_min\": %.3f, \"iterations\": %llu, \"repetitions\": %d",
+                         r.nsPerOp,r.nsPerOpMin,(unsigned long long)r.iterations,r.repetitions);
+                out << ((i == 0) ? "\n" : ",\n")
+                    << "    { \"name\": " << Quote(r.name) << ", \"unit\": " << Quote(r.unit) << ", " << numbers << " }";
+            }
+            out << "\n  ]\n}\n";
+        }
+    };
+}
+
+#endif
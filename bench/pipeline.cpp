@@ -0,0 +1,192 @@
+// Microbenchmark: primitives passing data between threads of the pipeline.
+// PipeOut: send and receive in one thread, round trip between two threads.
+// Broadcast (serve of frames): publish and consume by 1..cMaxReaders readers,
+// in one thread and with every reader in its own thread (time until all readers got the frame).
+// SignalOut: send and receive in one thread, round trip between two threads.
+
+#include "pipeline/pipeout.h"
+#include "pipeline/broadcast.h"
+#include "pipeline/signalout.h"
+#include "hiddev/hiddevreader.h"
+#include "harness.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace kmicki::pipeline;
+using namespace kmicki::bench;
+
+typedef kmicki::hiddev::HidDevReader::frame_t frame_t;
+
+static const int cFrameLen = 64;
+static const int cServeDepth = 16;      // depth of frame serve (as in HidDevReader)
+static const int cMaxReaders = 8;
+
+static void RunPipeOut(Harness & harness)
+{
+    PipeOut<int64_t> ping, pong;
+
+    harness.Run("pipeout/send_receive",[&](uint64_t iterations)
+    {
+        auto const& received = ping.GetPointer();
+        int64_t sum = 0;
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            ping.GetDataToFill() = i;
+            ping.SendData();
+            if(ping.TryData())
+                sum += *received;
+        }
+        DoNotOptimize(sum);
+    });
+
+    // echo thread sends every received value back, negative value stops it
+    std::thread echo([&]()
+    {
+        auto const& received = ping.GetPointer();
+        while(true)
+        {
+            ping.WaitForData();
+            auto value = *received;
+            pong.GetDataToFill() = value;
+            pong.SendData();
+            if(value < 0)
+                break;
+        }
+    });
+
+    harness.Run("pipeout/round_trip",[&](uint64_t iterations)
+    {
+        auto const& received = pong.GetPointer();
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            ping.GetDataToFill() = i;
+            ping.SendData();
+            pong.WaitForData();
+            if(*received != (int64_t)i)
+                printf("pipeout/round_trip: wrong value received\n");
+        }
+    },"roundtrip");
+
+    ping.GetDataToFill() = -1;
+    ping.SendData();
+    echo.join();
+}
+
+static void RunBroadcast(Harness & harness, int readerCount)
+{
+    Broadcast<frame_t> serve(new frame_t(cFrameLen),cServeDepth);
+    frame_t frame(cFrameLen);
+    auto suffix = "/" + std::to_string(readerCount);
+
+    {
+        std::vector<std::unique_ptr<Broadcast<frame_t>::Reader>> readers;
+        for(int r = 0; r < readerCount; ++r)
+            readers.emplace_back(new Broadcast<frame_t>::Reader(serve));
+
+        harness.Run("broadcast/publish_consume"+suffix,[&](uint64_t iterations)
+        {
+            unsigned checksum = 0;
+            for(uint64_t i = 0; i < iterations; ++i)
+            {
+                frame[0] = (char)i;
+                serve.Publish(frame);
+                for(auto & reader : readers)
+                    if(reader->TryData())
+                        checksum += (unsigned char)(*reader->GetPointer())[0];
+            }
+            DoNotOptimize(checksum);
+        },"frame");
+    }
+
+    // readers in own threads acknowledge every frame, next frame is published when all of them got it
+    std::atomic<uint64_t> acknowledged(0);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for(int r = 0; r < readerCount; ++r)
+        threads.emplace_back([&]()
+        {
+            Broadcast<frame_t>::Reader reader(serve);
+            acknowledged.fetch_add(1);
+            while(!stop)
+                if(reader.WaitForData())
+                    acknowledged.fetch_add(1);
+        });
+    while(acknowledged.load() < (uint64_t)readerCount)
+        std::this_thread::yield();
+
+    harness.Run("broadcast/fan_out"+suffix,[&](uint64_t iterations)
+    {
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            auto expected = acknowledged.load() + readerCount;
+            serve.Publish(frame);
+            while(acknowledged.load(std::memory_order_acquire) < expected)
+                std::this_thread::yield();
+        }
+    },"frame");
+
+    stop = true;
+    serve.Flush();
+    for(auto & thread : threads)
+        thread.join();
+}
+
+static void RunSignalOut(Harness & harness)
+{
+    SignalOut ping, pong;
+
+    harness.Run("signalout/send_try",[&](uint64_t iterations)
+    {
+        unsigned count = 0;
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            ping.SendSignal();
+            count += ping.TrySignal();
+        }
+        DoNotOptimize(count);
+    },"signal");
+
+    std::atomic<bool> stop(false);
+    std::thread echo([&]()
+    {
+        while(true)
+        {
+            ping.WaitForSignal();
+            if(stop)
+                break;
+            pong.SendSignal();
+        }
+    });
+
+    harness.Run("signalout/round_trip",[&](uint64_t iterations)
+    {
+        for(uint64_t i = 0; i < iterations; ++i)
+        {
+            ping.SendSignal();
+            pong.WaitForSignal();
+        }
+    },"roundtrip");
+
+    stop = true;
+    ping.SendSignal();
+    echo.join();
+}
+
+int main()
+{
+    printf("Pipeline primitives, %d-byte frames, serve depth %d\n",cFrameLen,cServeDepth);
+
+    Harness harness("pipeline");
+    RunPipeOut(harness);
+    for(int readers = 1; readers <= cMaxReaders; readers *= 2)
+        RunBroadcast(harness,readers);
+    RunSignalOut(harness);
+
+    return 0;
+}
@@ -0,0 +1,416 @@
+// Benchmark: single-threaded mode (Reactor) end to end, with epoll and io_uring (build with IOURING=1).
+// Frames replayed from a capture (first argument) or generated ones are written into a FIFO
+// that stands in for the hidraw device of a Reactor running in its own thread.
+// Local DSU clients subscribe to the Reactor's server. Time of a frame is measured
+// from writing it into the FIFO until every client received its data packet.
+// System calls made by the Reactor's thread are counted in a separate, untimed pass:
+// seccomp user notification reports every system call of that thread to a counting thread.
+
+#include "sdgyrodsu/reactor.h"
+#include "sdgyrodsu/sdhidframe.h"
+#include "hiddev/capture.h"
+#include "cemuhook/cemuhookprotocol.h"
+#include "cemuhook/crc32.h"
+#include "log/log.h"
+#include "harness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+using namespace kmicki::sdgyrodsu;
+using namespace kmicki::hiddev;
+using namespace kmicki::cemuhook;
+using namespace kmicki::cemuhook::protocol;
+using namespace kmicki::bench;
+
+static const int cGeneratedFrameLen = 64;
+static const int cGeneratedFrames = 256;
+static const int cClients = 4;
+static const int cWarmupFrames = 1000;
+static const int cIterations = 20000;
+static const int cCountedFrames = 2000;
+static const int cSubscribePeriodMs = 500;
+static const int cFrameTimeoutMs = 1000;
+static const uint32_t cDataType = 0x100002;
+static const std::vector<char> cStartMarker = { 0x01, 0x00, 0x09, 0x40 };
+
+// Source of frames: capture or generated
+struct Frames
+{
+    int len;
+    std::vector<std::vector<char>> data;
+    uint32_t increment = 0;
+
+    // Next frame, with increasing counter (otherwise Reactor drops repeated frames).
+    std::vector<char> & Next()
+    {
+        auto & frame = data[increment%data.size()];
+        ++increment;
+        memcpy(frame.data()+offsetof(SdHidFrame,Increment),&increment,sizeof(increment));
+        return frame;
+    }
+};
+
+// Controller lying on a table: noise of accelerometer and gyro.
+static Frames LoadFrames(char const* capturePath)
+{
+    Frames frames;
+    if(capturePath != nullptr)
+    {
+        CaptureReader capture(capturePath);
+        if(capture.IsOpen() && capture.GetCount() > 0 && capture.GetDataLen() >= (int)sizeof(SdHidFrame))
+        {
+            frames.len = capture.GetDataLen();
+            for(uint64_t i = 0; i < capture.GetCount(); ++i)
+                frames.data.emplace_back(capture.GetData(i),capture.GetData(i)+frames.len);
+            printf("Replaying %zu frames of %d bytes from %s\n",frames.data.size(),frames.len,capturePath);
+            return frames;
+        }
+        printf("Failed to read capture %s. Using generated frames.\n",capturePath);
+    }
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> noise(-300,300);
+    frames.len = cGeneratedFrameLen;
+    for(int i = 0; i < cGeneratedFrames; ++i)
+    {
+        SdHidFrame sdFrame = {};
+        memcpy(&sdFrame.Header,cStartMarker.data(),cStartMarker.size());
+        sdFrame.AccelAxisRightToLeft = noise(random);
+        sdFrame.AccelAxisFrontToBack = noise(random);
+        sdFrame.AccelAxisTopToBottom = 0x4000 + noise(random);
+        sdFrame.GyroAxisRightToLeft = noise(random)/10;
+        sdFrame.GyroAxisFrontToBack = noise(random)/10;
+        sdFrame.GyroAxisTopToBottom = noise(random)/10;
+        std::vector<char> frame(frames.len,0);
+        memcpy(frame.data(),&sdFrame,sizeof(sdFrame));
+        frames.data.push_back(frame);
+    }
+    return frames;
+}
+
+// As on the wire (SubscribeRequest has padding).
+struct SubscribePacket
+{
+    Header header;
+    uint8_t mask;
+    uint8_t slot;
+    uint8_t mac[6];
+} __attribute__((packed));
+
+// DSU clients on loopback subscribed to all slots of the server at given port.
+// A separate thread counts received packets and renews subscriptions.
+struct Clients
+{
+    std::vector<int> fds;
+    std::atomic<bool> stop;
+    std::atomic<uint64_t> received;
+    std::thread drain;
+
+    Clients(uint16_t const& port) : stop(false), received(0)
+    {
+        int epollFd = epoll_create1(0);
+        sockaddr_in server = {};
+        server.sin_family = AF_INET;
+        server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        server.sin_port = htons(port);
+        for(int i = 0; i < cClients; ++i)
+        {
+            int fd = socket(AF_INET,SOCK_DGRAM | SOCK_NONBLOCK,0);
+            int bufLen = 4*1024*1024;
+            setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&bufLen,sizeof(bufLen));
+            connect(fd,(sockaddr*)&server,sizeof(server));
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epollFd,EPOLL_CTL_ADD,fd,&event);
+            fds.push_back(fd);
+        }
+        Subscribe();
+        drain = std::thread([this,epollFd]()
+        {
+            char buf[256];
+            epoll_event events[cClients];
+            auto subscribed = std::chrono::steady_clock::now();
+            while(!stop)
+            {
+                int count = epoll_wait(epollFd,events,cClients,10);
+                for(int i = 0; i < count; ++i)
+                    while(recv(events[i].data.fd,buf,sizeof(buf),0) > 0)
+                        received.fetch_add(1,std::memory_order_release);
+                if(std::chrono::steady_clock::now()-subscribed > std::chrono::milliseconds(cSubscribePeriodMs))
+                {
+                    Subscribe();
+                    subscribed = std::chrono::steady_clock::now();
+                }
+            }
+            close(epollFd);
+        });
+    }
+
+    ~Clients()
+    {
+        stop = true;
+        drain.join();
+        for(auto fd : fds)
+            close(fd);
+    }
+
+    void Subscribe()
+    {
+        for(int i = 0; i < cClients; ++i)
+        {
+            SubscribePacket packet = {};
+            memcpy(packet.header.magic,"DSUC",4);
+            packet.header.version = 1001;
+            packet.header.length = sizeof(packet) - sizeof(Header) + sizeof(packet.header.eventType);
+            packet.header.id = i+1;
+            packet.header.eventType = cDataType;
+            packet.header.crc32 = Crc32(&packet,sizeof(packet));
+            send(fds[i],&packet,sizeof(packet),MSG_DONTWAIT);
+        }
+    }
+};
+
+// Counts system calls of the thread that calls Install, while counting is on.
+// Every system call of that thread waits until the counting thread lets it continue,
+// so the thread is much slower than usual.
+struct SyscallCounter
+{
+    std::atomic<int> fd;
+    std::atomic<bool> counting;
+    std::atomic<uint64_t> count;
+    std::thread supervisor;
+
+    SyscallCounter() : fd(-1), counting(false), count(0) {}
+
+    ~SyscallCounter()
+    {
+        if(supervisor.joinable())
+            supervisor.join();
+        if(fd >= 0)
+            close(fd);
+    }
+
+    // Called by counted thread. Threads it creates later are counted too.
+    bool Install()
+    {
+        sock_filter filter[] = { BPF_STMT(BPF_RET | BPF_K,SECCOMP_RET_USER_NOTIF) };
+        sock_fprog program = { 1, filter };
+        if(prctl(PR_SET_NO_NEW_PRIVS,1,0,0,0) < 0)
+            return false;
+        int listener = syscall(SYS_seccomp,SECCOMP_SET_MODE_FILTER,SECCOMP_FILTER_FLAG_NEW_LISTENER,&program);
+        if(listener < 0)
+            return false;
+        fd = listener;
+        return true;
+    }
+
+    // Start counting thread. It has to be created by a thread that isn't counted.
+    // It ends when counted thread exits.
+    void Supervise()
+    {
+        supervisor = std::thread([this]()
+        {
+            seccomp_notif_sizes sizes;
+            syscall(SYS_seccomp,SECCOMP_GET_NOTIF_SIZES,0,&sizes);
+            std::vector<char> requestData(std::max<size_t>(sizes.seccomp_notif,sizeof(seccomp_notif)));
+            std::vector<char> responseData(std::max<size_t>(sizes.seccomp_notif_resp,sizeof(seccomp_notif_resp)));
+            auto request = reinterpret_cast<seccomp_notif*>(requestData.data());
+            auto response = reinterpret_cast<seccomp_notif_resp*>(responseData.data());
+            while(true)
+            {
+                pollfd notification = { fd, POLLIN, 0 };
+                if(poll(&notification,1,-1) < 0)
+                    continue;
+                if(notification.revents & POLLHUP)
+                    break;
+                memset(request,0,requestData.size());
+                if(ioctl(fd,SECCOMP_IOCTL_NOTIF_RECV,request) < 0)
+                    continue;
+                if(counting.load(std::memory_order_relaxed))
+                    ++count;
+                memset(response,0,responseData.size());
+                response->id = request->id;
+                response->flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+                ioctl(fd,SECCOMP_IOCTL_NOTIF_SEND,response);
+            }
+        });
+    }
+};
+
+// Free UDP port on loopback for Reactor's server (it takes the port from SDGYRO_SERVER_PORT).
+static uint16_t FindFreePort()
+{
+    int fd = socket(AF_INET,SOCK_DGRAM,0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd,(sockaddr*)&address,sizeof(address));
+    socklen_t len = sizeof(address);
+    getsockname(fd,(sockaddr*)&address,&len);
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+// Write a frame and wait until every client received its packet.
+static bool DeliverFrame(Frames & frames, int writeFd, Clients & clients, uint64_t & expected)
+{
+    if(write(writeFd,frames.Next().data(),frames.len) != frames.len)
+        return false;
+    expected += cClients;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(cFrameTimeoutMs);
+    while(clients.received.load(std::memory_order_acquire) < expected)
+    {
+        if(std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// Run Reactor reading the FIFO and deliver frames through it.
+// Without counter, delivery of frames is timed. With counter, system calls of Reactor's thread are counted.
+static void RunReactor(Harness & harness, std::string const& name, Frames & frames, std::string const& fifoPath, int writeFd,
+                       bool const& ioUring, SyscallCounter * counter)
+{
+    auto port = FindFreePort();
+    setenv("SDGYRO_SERVER_PORT",std::to_string(port).c_str(),1);
+
+    std::atomic<int> state(0);   // 1 - running, -1 - failed
+    std::thread thread([&]()
+    {
+        try
+        {
+            Reactor reactor(fifoPath,frames.len,cStartMarker,ioUring);
+            if(counter != nullptr && !counter->Install())
+            {
+                state = -1;
+                return;
+            }
+            state = 1;
+            reactor.Run();
+        }
+        catch(std::exception const& e)
+        {
+            printf("%s: %s\n",name.c_str(),e.what());
+            state = -1;
+        }
+    });
+    while(state == 0)
+        std::this_thread::yield();
+    if(state < 0)
+    {
+        if(counter != nullptr)
+            printf("%s: seccomp user notification not available, system calls not counted\n",name.c_str());
+        thread.join();
+        return;
+    }
+    if(counter != nullptr)
+        counter->Supervise();
+
+    bool delivered = true;
+    {
+        Clients clients(port);
+
+        // frames are dropped until Reactor gets the subscription
+        uint64_t expected = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while(clients.received < cClients && std::chrono::steady_clock::now() < deadline)
+        {
+            write(writeFd,frames.Next().data(),frames.len);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        expected = clients.received;
+        for(int i = 0; delivered && i < cWarmupFrames; ++i)
+            delivered = DeliverFrame(frames,writeFd,clients,expected);
+
+        int frameCount = (counter != nullptr) ? cCountedFrames : cIterations;
+        auto start = std::chrono::steady_clock::now();
+        if(counter != nullptr)
+            counter->counting = true;
+        for(int i = 0; delivered && i < frameCount; ++i)
+            delivered = DeliverFrame(frames,writeFd,clients,expected);
+        if(counter != nullptr)
+            counter->counting = false;
+        auto ns = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count()/frameCount;
+
+        if(!delivered)
+            printf("%s: packets not delivered to all clients (%llu of %llu)\n",name.c_str(),
+                   (unsigned long long)clients.received.load(),(unsigned long long)expected);
+        else if(counter != nullptr)
+            printf("%-40s %10.2f syscalls/frame\n",name.c_str(),(double)counter->count/frameCount);
+        else
+            harness.Report(name,ns,frameCount,"frame");
+    }
+
+    pthread_kill(thread.native_handle(),SIGTERM);
+    thread.join();
+}
+
+int main(int argc, char ** argv)
+{
+    kmicki::log::SetLogLevel(kmicki::log::LogLevelNone);
+
+    auto frames = LoadFrames(argc > 1 ? argv[1] : nullptr);
+
+    char dir[] = "/tmp/sdgyrobenchXXXXXX";
+    if(mkdtemp(dir) == nullptr)
+    {
+        printf("Failed to create temporary directory\n");
+        return 1;
+    }
+    std::string fifoPath = std::string(dir)+"/hid";
+    mkfifo(fifoPath.c_str(),0600);
+    // read-write end doesn't block on open and keeps the FIFO open for readers
+    int writeFd = open(fifoPath.c_str(),O_RDWR);
+
+    printf("Reactor, %d-byte frames, %d clients\n",frames.len,cClients);
+    {
+        Harness harness("uring");
+
+        RunReactor(harness,"uring/reactor_epoll",frames,fifoPath,writeFd,false,nullptr);
+#ifdef SDGYRO_IO_URING
+        RunReactor(harness,"uring/reactor_io_uring",frames,fifoPath,writeFd,true,nullptr);
+#else
+        printf("io_uring: not built (make bench IOURING=1)\n");
+#endif
+
+        SyscallCounter epollCounter;
+        RunReactor(harness,"uring/reactor_epoll",frames,fifoPath,writeFd,false,&epollCounter);
+#ifdef SDGYRO_IO_URING
+        SyscallCounter uringCounter;
+        RunReactor(harness,"uring/reactor_io_uring",frames,fifoPath,writeFd,true,&uringCounter);
+#endif
+    }
+
+    close(writeFd);
+    unlink(fifoPath.c_str());
+    rmdir(dir);
+    return 0;
+}
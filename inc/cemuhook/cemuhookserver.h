@@ -3,9 +3,15 @@
 
 #include "sdgyrodsu/cemuhookadapter.h"
 #include "cemuhookprotocol.h"
+#include "pipeline/realtime.h"
 #include <thread>
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <array>
+#include <vector>
 
 using namespace kmicki::cemuhook::protocol;
 
@@ -14,12 +20,68 @@ namespace kmicki::cemuhook
     class Server
     {
         public:
+        // Number of controller slots in DSU protocol.
+        static const int cSlotCount = 4;
+
         Server() = delete;
 
-        Server(sdgyrodsu::CemuhookAdapter & _motionSource);
+        // Server with single controller in slot 0.
+        // receiveProfile, sendProfile: scheduling profiles of receiving and sending threads.
+        Server(sdgyrodsu::CemuhookAdapter & _motionSource, 
+               pipeline::RealtimeProfile const& _receiveProfile = pipeline::RealtimeProfile(), 
+               pipeline::RealtimeProfile const& _sendProfile = pipeline::RealtimeProfile());
+
+        // Server with controllers in slots.
+        // motionSources: source of motion data for each slot (index is slot number, nullptr - no controller).
+        //                Data of each slot is sent by its own thread.
+        // receiveProfile, sendProfile: scheduling profiles of receiving and sending threads.
+        Server(std::vector<sdgyrodsu::CemuhookAdapter*> const& _motionSources, 
+               pipeline::RealtimeProfile const& _receiveProfile = pipeline::RealtimeProfile(), 
+               pipeline::RealtimeProfile const& _sendProfile = pipeline::RealtimeProfile());
+
+        // Server without own threads, driven by an external event loop.
+        // Controller is in slot 0.
+        // Requests are handled by ReceiveRequests when socket is readable,
+        // data is sent by SendData, clients expire through TickClientTimeout.
+        Server(sdgyrodsu::CemuhookAdapter & _motionSource, bool const& externalLoop);
 
         ~Server();
 
+        // Socket file descriptor (for external event loop).
+        int GetSocketFd();
+
+        // Handle all pending requests without blocking.
+        // Returns true if there are clients subscribed for data.
+        bool ReceiveRequests();
+
+        // Send motion data of slot 0 to all clients subscribed to it.
+        void SendData(MotionData const& motion);
+
+        // Are there clients subscribed for data?
+        bool HasClients();
+
+        // Count period without requests for all clients and drop the ones that timed out.
+        void TickClientTimeout();
+
+        // Function that sends data packet to a client.
+        // Packet is gathered from count buffers in vecs, valid only during the call.
+        typedef std::function<void(iovec const* vecs, int const& count, sockaddr_in const& address)> sender_t;
+
+        // Send data packets through given function instead of sending them on the socket right away
+        // (for external event loop that batches sends). Empty function restores sending on the socket.
+        void SetSender(sender_t const& _sender);
+
+        // Client subscribed for data.
+        struct ClientInfo
+        {
+            sockaddr_in address;
+            uint8_t slots;          // bit mask of subscribed slots
+            uint64_t packets;       // data packets sent to the client (all slots)
+        };
+
+        // Get subscribed clients.
+        std::vector<ClientInfo> GetClients();
+
         private:
 
         struct Client
@@ -27,32 +89,71 @@ namespace kmicki::cemuhook
             sockaddr_in address;
             uint32_t id;
             int sendTimeout;
+            uint8_t slots;      // bit mask of subscribed slots
+
+            // Header of data packet of each slot, with id of the client and CRC of the packet.
+            // Sent together with payload of the slot's current frame.
+            std::array<Header,cSlotCount> dataHeaders;
+
+            // Data packets sent of each slot. Written only by sending thread of the slot.
+            std::array<uint64_t,cSlotCount> packets;
 
             bool operator==(sockaddr_in const& other);
             bool operator!=(sockaddr_in const& other);
         };
 
+        // Controller slot. Has own data packet and sending thread.
+        struct Slot
+        {
+            sdgyrodsu::CemuhookAdapter * motionSource;
+            // Data packet of current frame with id 0. Not modified until next frame.
+            // Clients get its payload (everything after the header) with their own headers.
+            DataEvent dataAnswer;
+            uint32_t packet;
+
+            bool stopSending;
+            std::mutex stopSendMutex;
+            std::unique_ptr<std::thread> sendThread;
+
+            // Messages to all subscribed clients of a frame, sent together in one call.
+            // Have room for all clients (reserved when a client is added).
+            std::vector<iovec> batchVecs;       // header and payload for each client
+            std::vector<mmsghdr> batchMessages;
+        };
+
         std::mutex mainMutex;
-        std::mutex stopSendMutex;
-        std::mutex socketSendMutex;
         std::shared_mutex clientsMutex;
 
         bool stop;
-        bool stopSending;
+        bool externalLoop;
 
         int socketFd;
 
-        sdgyrodsu::CemuhookAdapter & motionSource;
+        std::array<Slot,cSlotCount> slots;
+        uint8_t availableSlots;     // bit mask of slots with controller
         std::unique_ptr<std::thread> serverThread;
 
+        pipeline::RealtimeProfile receiveProfile;
+        pipeline::RealtimeProfile sendProfile;
+
+        sender_t sender;
+
         void serverTask();
-        void sendTask();
+        void sendTask(int slotNo);
         void Start();
 
+        void AssignSlots(std::vector<sdgyrodsu::CemuhookAdapter*> const& motionSources);
+
+        // Handle a request received from a client.
+        // Returns true if a client subscribed for data of a slot it didn't receive yet.
+        bool HandleRequest(char * buf, ssize_t const& len, sockaddr_in const& sockInClient);
+
+        // Send prepared data answer of a slot to all clients subscribed to it.
+        void SendDataAnswer(int const& slotNo);
+
         VersionData versionAnswer;
         InfoAnswer infoDeckAnswer;
         InfoAnswer infoNoneAnswer;
-        DataEvent dataAnswer;
 
         bool checkTimeout;
 
@@ -60,14 +161,30 @@ namespace kmicki::cemuhook
 
         std::pair<uint16_t , void const*> PrepareVersionAnswer(uint32_t const& id);
         std::pair<uint16_t , void const*> PrepareInfoAnswer(uint32_t const& id, uint8_t const& slot);
-        std::pair<uint16_t , void const*> PrepareDataAnswer(uint32_t const& d, uint32_t const& packet);
-        std::pair<uint16_t , void const*> PrepareDataAnswerWithoutCrc(uint32_t const& d, uint32_t const& packet);
-        void ModifyDataAnswerId(uint32_t const& id);
-        void CalcCrcDataAnswer();
+        std::pair<uint16_t , void const*> PrepareDataAnswer(Slot & slot, uint32_t const& d, uint32_t const& packet);
+        std::pair<uint16_t , void const*> PrepareDataAnswerWithoutCrc(Slot & slot, uint32_t const& d, uint32_t const& packet);
+        // Fill data packet header of a client from header of data answer with valid CRC (CRC is patched for id).
+        void PrepareDataHeader(Header & header, DataEvent const& dataAnswer, uint32_t const& id);
+        void CalcCrcDataAnswer(DataEvent & dataAnswer);
 
         std::vector<Client> clients;
 
-        void CheckClientTimeout(std::unique_ptr<std::thread> & sendThread, bool increment);
+        // Make room for messages to all clients in batches of all slots.
+        // Called with exclusive lock of clients.
+        void ReserveBatches();
+
+        // Slots that have subscribed clients.
+        uint8_t GetSubscribedSlots();
+
+        // Start sending threads of slots that got clients.
+        void StartSending();
+        // Stop sending thread of a slot.
+        void StopSending(Slot & slot);
+
+        void CheckClientTimeout(bool increment);
+
+        // Drop clients that timed out. Returns true if no clients are left.
+        bool RemoveTimedOutClients(bool increment);
     };
 }
 
@@ -0,0 +1,58 @@
+#ifndef _KMICKI_CEMUHOOK_CRC32_H_
+#define _KMICKI_CEMUHOOK_CRC32_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kmicki::cemuhook
+{
+    // CRC-32 (IEEE 802.3, same as zlib's crc32) of data.
+    // crc: CRC of preceding data, to continue calculation (0 for start).
+    // Uses fastest implementation supported by the CPU.
+    uint32_t Crc32(void const* data, size_t len, uint32_t crc = 0);
+
+    // Name of the implementation used by Crc32 ("pclmul", "armv8", "slice8").
+    char const* GetCrc32KernelName();
+
+    // Updates CRC-32 of a message of fixed length when only a 4-byte field at fixed offset changes.
+    // CRC is linear in message bits, so the change of CRC depends only on the change of the field
+    // and its distance from the end of the message. That is precomputed for every value of every byte
+    // of the field, so the update takes 4 lookups instead of calculating CRC of the whole message.
+    class Crc32Patch
+    {
+        public:
+        Crc32Patch() = delete;
+        Crc32Patch(size_t const& messageLen, size_t const& fieldOffset);
+
+        // CRC of the message after the field changed from oldField to newField.
+        uint32_t operator()(uint32_t const& crc, uint32_t const& oldField, uint32_t const& newField) const;
+
+        private:
+        uint32_t table[4][256];
+    };
+
+    // Particular implementations (for benchmarking and verification).
+    namespace kernel
+    {
+        // Bit by bit, 8 steps per byte.
+        uint32_t Crc32Bitwise(void const* data, size_t len, uint32_t crc = 0);
+        // 8 bytes per step using 8 lookup tables.
+        uint32_t Crc32Slice8(void const* data, size_t len, uint32_t crc = 0);
+#if defined(__x86_64__) || defined(__i386__)
+        // Folding 64 bytes per step with carry-less multiplication.
+        uint32_t Crc32Pclmul(void const* data, size_t len, uint32_t crc = 0);
+
+        // Is PCLMUL implementation supported by the CPU?
+        bool IsPclmulSupported();
+#endif
+#if defined(__aarch64__)
+        // CRC32 instructions of ARMv8.
+        uint32_t Crc32Armv8(void const* data, size_t len, uint32_t crc = 0);
+
+        // Are ARMv8 CRC32 instructions supported by the CPU?
+        bool IsArmv8CrcSupported();
+#endif
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _KMICKI_HIDDEV_CAPTURE_H_
+#define _KMICKI_HIDDEV_CAPTURE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kmicki::hiddev
+{
+    // Capture file format:
+    // CaptureHeader followed by fixed-length records, so record N is at offset sizeof(CaptureHeader)+N*recordLen.
+    // Record: 64-bit CLOCK_MONOTONIC timestamp in ns, then dataLen bytes of data padded to 8 bytes.
+    // All values are little-endian.
+    struct CaptureHeader
+    {
+        char magic[8];          // cCaptureMagic
+        uint32_t version;       // cCaptureVersion
+        uint32_t flags;         // CaptureFlag*
+        uint32_t dataLen;       // length of data in a record
+        uint32_t recordLen;     // length of whole record
+        uint64_t recordCount;   // number of records written (informational, file length is decisive)
+    };
+
+    enum CaptureFlag
+    {
+        CaptureFlagHiddevRecords = 1    // data are raw hiddev records instead of HID reports
+    };
+
+    // Writes captured data. Records are buffered in blocks.
+    // Full blocks are written to the file by a background thread,
+    // so the thread that adds records (reading the device) never waits for the disk.
+    class CaptureWriter
+    {
+        public:
+        CaptureWriter() = delete;
+        CaptureWriter(std::string const& path, uint32_t const& dataLen, uint32_t const& flags);
+        ~CaptureWriter();
+
+        bool IsOpen();
+
+        // Add record with given data and timestamp.
+        void Write(std::vector<char> const& data, uint64_t const& timestampNs);
+
+        // Hand buffered records to the background thread for writing.
+        void Flush();
+
+        private:
+        int file;
+        CaptureHeader header;           // record count is updated by background thread
+        size_t blockLen;
+        std::vector<char> buffer;       // block being filled
+        size_t bufferPos;
+
+        std::mutex blocksMutex;
+        std::condition_variable blocksCV;
+        std::deque<std::vector<char>> fullBlocks;
+        std::vector<std::vector<char>> freeBlocks;
+        uint64_t droppedRecords;        // records lost because writing fell behind
+        bool stop;
+        std::atomic<bool> failed;       // writing to the file failed
+        std::thread writer;
+
+        void writerTask();
+    };
+
+    // Reads capture file mapped to memory.
+    class CaptureReader
+    {
+        public:
+        CaptureReader() = delete;
+        CaptureReader(std::string const& path);
+        ~CaptureReader();
+
+        bool IsOpen();
+
+        uint64_t const& GetCount();
+        uint32_t const& GetDataLen();
+        uint32_t const& GetFlags();
+
+        uint64_t GetTimestamp(uint64_t const& index);
+        char const* GetData(uint64_t const& index);
+
+        private:
+        char const* map;
+        size_t mapLen;
+        uint64_t count;
+        CaptureHeader header;
+    };
+
+    // Current CLOCK_MONOTONIC time in ns.
+    uint64_t GetMonotonicNs();
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _KMICKI_HIDDEV_DEVICEMONITOR_H_
+#define _KMICKI_HIDDEV_DEVICEMONITOR_H_
+
+#include <cstdint>
+#include <set>
+#include <string>
+
+#include "pipeline/thread.h"
+
+typedef struct sd_device sd_device;
+typedef struct sd_device_monitor sd_device_monitor;
+
+namespace kmicki::hiddev
+{
+    // Watches hidraw devices of given USB device being connected and disconnected (udev events).
+    // Lets readers reopen the device as soon as it reappears.
+    class DeviceMonitor : public pipeline::Thread
+    {
+        public:
+        DeviceMonitor() = delete;
+        DeviceMonitor(uint16_t const& _vId, uint16_t const& _pId);
+        ~DeviceMonitor();
+
+        // File descriptor that becomes readable when matching device is connected.
+        // Include it in poll sets of waits for the device.
+        int GetAddedFd();
+
+        // Check if matching device was connected since last call.
+        bool TryAdded();
+
+        protected:
+        void Execute() override;
+        void FlushPipes() override;
+
+        private:
+        uint16_t vId;
+        uint16_t pId;
+        int addedFd;
+
+        // syspaths of matching devices that are connected
+        std::set<std::string> devices;
+
+        void FindConnected();
+        void HandleEvent(sd_device *device);
+        static int HandleEvent(sd_device_monitor *monitor, sd_device *device, void *userdata);
+    };
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef _KMICKI_HIDDEV_HIDAPIDEV_
 #define _KMICKI_HIDDEV_HIDAPIDEV_
 
+#ifndef SDGYRO_NO_HIDAPI
+
 #include <stdint.h>
 #include <vector>
 #include <hidapi/hidapi.h>
@@ -15,6 +17,7 @@ namespace kmicki::hiddev
         ~HidApiDev();
 
         bool Open();
+        // Read data. Returns number of bytes read (0 on timeout) or -1 on error.
         int Read(std::vector<char> & data);
         bool Close();
         bool IsOpen();
@@ -32,4 +35,6 @@ namespace kmicki::hiddev
     };
 }
 
-#endif
\ No newline at end of file
+#endif // SDGYRO_NO_HIDAPI
+
+#endif
@@ -15,12 +15,16 @@ namespace kmicki::hiddev
         HidDevFile(std::string const& _filePath, int readTimeoutUs, bool const& open = true);
 
         bool Open();
+        // Read data. Returns 0 on timeout or when woken up through wake file descriptor.
         int Read(std::vector<char> & data);
         bool Close();
         bool IsOpen();
 
+        // Set file descriptor that interrupts waiting for data when it becomes readable.
+        void SetWakeFd(int wakeFd);
+
         private:
-        pollfd fileDescriptors[1];
+        pollfd fileDescriptors[2];
         int & file;
         std::string filePath;
         timespec timeout;
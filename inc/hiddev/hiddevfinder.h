@@ -3,10 +3,18 @@
 
 #include <cstdint>
 
+typedef struct sd_device sd_device;
+
 namespace kmicki::hiddev
 {
     // find which X among /dev/usb/hiddevX fits provided VID+PID
     int FindHidDevNo(uint16_t vid, uint16_t pid);
+
+    // find which X among /dev/hidrawX fits provided VID+PID and USB interface number
+    int FindHidRawNo(uint16_t vid, uint16_t pid, int interfaceNumber);
+
+    // check if device belongs to USB device with provided VID+PID
+    bool IsUsbProduct(sd_device *device, uint16_t vid, uint16_t pid);
 }
 
 #endif
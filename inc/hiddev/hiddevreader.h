@@ -2,28 +2,51 @@
 #define _KMICKI_HIDDEV_HIDDEVREADER_H_
 
 #include <vector>
-#include <shared_mutex>
+#include <mutex>
 
 #include "pipeline/thread.h"
 #include "pipeline/signalout.h"
 #include "pipeline/pipeout.h"
-#include "pipeline/serve.h"
+#include "pipeline/broadcast.h"
 
 #include "hiddevfile.h"
+#include "devicemonitor.h"
+#include "capture.h"
 
 using namespace kmicki::pipeline;
 
 namespace kmicki::hiddev 
 {
-    void HandleMissedTicks(std::string name, std::string tickName, bool received, int & ticks, int period, int & nonMissed);
-
     // Reads periodic data from a given HID device (/dev/usb/hiddevX)
     // in constant-length frames and provides most recent frame.
     class HidDevReader
     {
         public:
 
-        typedef std::vector<char> frame_t;
+        // Frame of HID data with host time (CLOCK_MONOTONIC, ns) when its read completed.
+        struct frame_t : public std::vector<char>
+        {
+            using std::vector<char>::vector;
+            uint64_t Timestamp = 0;
+        };
+        typedef Broadcast<frame_t>::Reader serve_t;
+
+        // Replay period that keeps timing of the capture.
+        static const int cReplayOriginalTiming;
+
+        // Parameters of generated frames (see constructor with SyntheticParams).
+        struct SyntheticParams
+        {
+            double rate = 250.0;            // frames per second
+            uint32_t startIncrement = 1;    // Increment of the first frame (set close to 0xFFFFFFFF to test wraparound)
+            double gapProbability = 0.0;    // probability that frames are skipped before a frame
+            int maxGap = 10;                // maximum number of skipped frames
+            double duplicateProbability = 0.0;  // probability that a frame is sent again
+            double zeroProbability = 0.0;   // probability of a frame with all IMU values zero (no gyro)
+            int burst = 1;                  // frames delivered back-to-back at once
+            int jitterUs = 0;               // maximum deviation of delivery time from the schedule
+            uint32_t seed = 1;              // random seed (same seed - same sequence)
+        };
 
         HidDevReader() = delete;
 
@@ -42,7 +65,7 @@ namespace kmicki::hiddev
 
         // Constructor.
         // Starts pipeline.
-        // Uses hidapi (hidraw) to obtain data from device.
+        // Reads data from the device's hidraw file (/dev/hidrawX) directly or through hidapi.
         // vId: vendor ID
         // pId: product ID
         // interfaceNumber: interface number of the device
@@ -53,7 +76,25 @@ namespace kmicki::hiddev
         //           If it will be much higher then the generated frames will be out of sync
         //           (a block of consecutive frames and then skip)
         // maxScanTime: maximum scan time
-        HidDevReader(uint16_t const& vId, uint16_t const& pId, const int& interfaceNumber, int const& _frameLen, int const& scanTimeUs);
+        // hidApi: use hidapi instead of reading hidraw file directly 
+        //         (ignored if built without hidapi - SDGYRO_NO_HIDAPI)
+        HidDevReader(uint16_t const& vId, uint16_t const& pId, const int& interfaceNumber, int const& _frameLen, int const& scanTimeUs, bool const& hidApi = false);
+
+        // Constructor.
+        // Starts pipeline.
+        // Replays data from a capture file (see SetCapture) in a loop.
+        // capturePath: path to the capture file
+        // replayPeriodUs: period between replayed frames, 
+        //                 cReplayOriginalTiming to keep timing of the capture, 0 to replay as fast as possible
+        // scanTime: Period between frames in ms (used only for data in hiddev format)
+        HidDevReader(std::string const& capturePath, int const& replayPeriodUs, int const& scanTimeUs);
+
+        // Constructor.
+        // Starts pipeline.
+        // Generates frames of Steam Deck controls instead of reading the device.
+        // params: parameters of generated frames and their delivery
+        // frameLen: Size of single HID data frame
+        HidDevReader(SyntheticParams const& params, int const& _frameLen);
 
         // Destructor. 
         // Stops pipeline.
@@ -64,15 +105,17 @@ namespace kmicki::hiddev
         void SetStartMarker(std::vector<char> const& marker);
 
         // Get frame serve
-        Serve<frame_t> & GetServe();
+        serve_t & GetServe();
 
         // Stop serving
-        void StopServe(Serve<frame_t> & _serve);
+        void StopServe(serve_t & _serve);
 
         // Start process of grabbing frames.
+        // Each Start has to be matched by Stop. Grabbing continues while any user needs it.
         void Start();
 
         // Stop process of grabbing frames
+        // (when it's not needed by other users anymore).
         void Stop();
 
         // Is grabbing frames in progress?
@@ -83,6 +126,14 @@ namespace kmicki::hiddev
 
         void SetNoGyro(SignalOut& _noGyro);
 
+        // Record all data read from the device into a capture file.
+        // Call before the pipeline is started.
+        // Returns false if the file couldn't be created.
+        bool SetCapture(std::string const& capturePath);
+
+        // Set scheduling profiles of pipeline threads. Applied when pipeline starts.
+        void SetRealtimeProfile(RealtimeProfile const& read, RealtimeProfile const& process, RealtimeProfile const& serve);
+
         private:
 
         // Pipeline threads
@@ -96,13 +147,33 @@ namespace kmicki::hiddev
 
             void SetStartMarker(std::vector<char> const& marker);
 
-            PipeOut<std::vector<char>> Data;
+            // Signal that gyro has to be reenabled (used by readers that can write to the device).
+            void SetNoGyro(SignalOut& _noGyro);
+
+            // Monitor of the device being connected (used by readers that wait for the device to reappear).
+            void SetDeviceMonitor(DeviceMonitor& _monitor);
+
+            // Write all data that is sent further into a capture.
+            void SetCapture(CaptureWriter* _capture);
+
+            PipeOut<frame_t> Data;
             SignalOut Unsynced;
 
             protected:
 
             void FlushPipes() override;
+
+            // Wait until the device may be available again:
+            // device monitor reports it connected, retry period passes or thread is woken up.
+            void WaitForDevice();
+
+            // Timestamp filled data and send it further (and capture it).
+            void SendData();
+
             std::vector<char> startMarker;
+            SignalOut *noGyro;
+            DeviceMonitor *monitor;
+            CaptureWriter *capture;
         };
 
         class ReadDataFile : public ReadData
@@ -119,10 +190,11 @@ namespace kmicki::hiddev
             void Execute() override;
 
             private:
-            bool CheckData(std::unique_ptr<std::vector<char>> const& data, ssize_t readCnt);
+            bool CheckData(std::unique_ptr<frame_t> const& data, ssize_t readCnt);
             HidDevFile inputFile;
         };
         
+#ifndef SDGYRO_NO_HIDAPI
         class ReadDataApi : public ReadData
         {
             public:
@@ -130,7 +202,24 @@ namespace kmicki::hiddev
             ReadDataApi(uint16_t const& vId, uint16_t const& pId, const int& _interfaceNumber, int const& _frameLen, int const& _scanTimeUs);
             ~ReadDataApi();
 
-            void SetNoGyro(SignalOut& _noGyro);
+            protected:
+
+            void Execute() override;
+
+            private:
+            uint16_t vId;
+            uint16_t pId;
+            int interfaceNumber;
+            int timeout;
+        };
+#endif
+
+        // Reads reports directly from /dev/hidrawX file.
+        class ReadDataRaw : public ReadData
+        {
+            public:
+            ReadDataRaw() = delete;
+            ReadDataRaw(uint16_t const& vId, uint16_t const& pId, const int& _interfaceNumber, int const& _frameLen, int const& _scanTimeUs);
 
             protected:
 
@@ -141,8 +230,43 @@ namespace kmicki::hiddev
             uint16_t pId;
             int interfaceNumber;
             int timeout;
+        };
 
-            SignalOut *noGyro;
+        // Replays data from a capture file.
+        class ReadDataReplay : public ReadData
+        {
+            public:
+            ReadDataReplay() = delete;
+            ReadDataReplay(std::unique_ptr<CaptureReader> && _replay, int const& _periodUs);
+
+            protected:
+
+            void Execute() override;
+
+            private:
+            std::unique_ptr<CaptureReader> replay;
+            int periodUs;
+
+            // Wait until given CLOCK_MONOTONIC time. Returns false if woken up earlier.
+            bool WaitUntil(uint64_t const& timeNs);
+        };
+
+        // Generates frames of Steam Deck controls.
+        class ReadDataSynthetic : public ReadData
+        {
+            public:
+            ReadDataSynthetic() = delete;
+            ReadDataSynthetic(SyntheticParams const& _params, int const& _frameLen);
+
+            protected:
+
+            void Execute() override;
+
+            private:
+            SyntheticParams params;
+
+            // Fill frame with IMU data of frame number n.
+            void Generate(std::vector<char> & frame, uint32_t const& increment, uint64_t const& n, bool const& zero);
         };
 
         class ProcessData : public Thread
@@ -162,7 +286,7 @@ namespace kmicki::hiddev
 
             private:
             ReadData & readData;
-            PipeOut<std::vector<char>> & data;
+            PipeOut<frame_t> & data;
 
             std::chrono::microseconds timeout;
         };
@@ -171,12 +295,12 @@ namespace kmicki::hiddev
         {
             public:
             ServeFrame() = delete;
-            ServeFrame(PipeOut<frame_t> & _frame);
+            ServeFrame(PipeOut<frame_t> & _frame, int const& depth);
             ~ServeFrame();
 
-            Serve<frame_t> & GetServe();
+            serve_t & GetServe();
 
-            void StopServe(Serve<frame_t> & serve);
+            void StopServe(serve_t & serve);
 
             protected:
 
@@ -184,29 +308,39 @@ namespace kmicki::hiddev
             void FlushPipes() override;
 
             private:
-            void WaitForServes();
-            void HandleMissedFrames(int &serveCnt, std::vector<int> &missedTicks, std::vector<int> &nonMissedTicks, std::vector<std::string> &serveNames);
             PipeOut<frame_t> & frame;
-            std::vector<std::unique_ptr<Serve<frame_t>>> frames;
-            std::vector<Serve<frame_t>::ServeLock> GetServeLocks();
-            std::shared_mutex framesMutex;
-            std::condition_variable_any framesCv;
+            Broadcast<frame_t> broadcast;
+            std::vector<std::unique_ptr<serve_t>> frames;
+            std::mutex framesMutex;
         };
 
         static const int cInputRecordLen;
         static const int cByteposInput;
+        static const int cFrameIdPos;
+        static const int cServeDepth;
+
+        // Get ID of the frame (its 32-bit counter) for tracing.
+        static uint32_t GetFrameId(frame_t const& frame);
+        // Get ID of the frame from raw hiddev records.
+        static uint32_t GetRecordsFrameId(std::vector<char> const& records);
 
         int frameLen;
 
         std::string inputFilePath;
         
         std::vector<std::unique_ptr<Thread>> pipeline;
+        std::unique_ptr<DeviceMonitor> monitor;
+        std::unique_ptr<CaptureWriter> capture;
         ServeFrame * serve;
+        ProcessData * processData;
         ReadData* readData;
-        ReadDataApi* readDataApi;
 
         // Mutex
         std::mutex startStopMutex;
+        int startCount = 0;     // users that started grabbing frames
+
+        // Stop threads of the pipeline (with startStopMutex locked).
+        void StopPipeline();
 
         void AddOperation(pipeline::Thread * operation);
 
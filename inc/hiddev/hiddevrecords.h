@@ -0,0 +1,43 @@
+#ifndef _KMICKI_HIDDEV_HIDDEVRECORDS_H_
+#define _KMICKI_HIDDEV_HIDDEVRECORDS_H_
+
+#include <cstddef>
+
+namespace kmicki::hiddev
+{
+    // hiddev file delivers every byte of HID data in a separate record (struct hiddev_event):
+    // 4 bytes of usage code followed by 4 bytes of value, of which the lowest byte is the data.
+    static const int cRecordLen = 8;        // Length of single hiddev record in bytes.
+    static const int cRecordBytePos = 4;    // Position of HID data byte in the record.
+
+    // Extract HID data bytes from hiddev records.
+    // out[i] = records[i*cRecordLen+cRecordBytePos] for i < count
+    // Uses fastest implementation supported by the CPU.
+    void ExtractRecordBytes(char const* records, char* out, size_t count);
+
+    // Check if HID data bytes held in the first count hiddev records are equal to given bytes.
+    bool RecordBytesEqual(char const* records, char const* bytes, size_t count);
+
+    // Check if hiddev records start at the beginning of a HID frame.
+    // First record's usage code tells where the frame starts. The alternative usage code
+    // is accepted only if HID data bytes of the following records match startMarker (if given).
+    bool IsRecordsFrameStart(char const* records, char const* startMarker, size_t markerLen);
+
+    // Name of the implementation used by ExtractRecordBytes ("avx2", "sse2" or "scalar").
+    char const* GetRecordKernelName();
+
+    // Particular implementations (for benchmarking).
+    namespace kernel
+    {
+        void ExtractRecordBytesScalar(char const* records, char* out, size_t count);
+#if defined(__x86_64__) || defined(__i386__)
+        void ExtractRecordBytesSse2(char const* records, char* out, size_t count);
+        void ExtractRecordBytesAvx2(char const* records, char* out, size_t count);
+
+        // Is AVX2 implementation supported by the CPU?
+        bool IsAvx2Supported();
+#endif
+    }
+}
+
+#endif
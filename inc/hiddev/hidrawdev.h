@@ -0,0 +1,47 @@
+#ifndef _KMICKI_HIDDEV_HIDRAWDEV_
+#define _KMICKI_HIDDEV_HIDRAWDEV_
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+namespace kmicki::hiddev
+{
+    // HID device accessed directly through /dev/hidrawX file.
+    // File is opened in nonblocking mode, so it can be watched by poll/epoll.
+    class HidRawDev
+    {
+        public:
+        HidRawDev() = delete;
+        HidRawDev(const uint16_t& _vId, const uint16_t _pId, const int& _interfaceNumber);
+        // Device file at given path instead of one found by IDs (e.g. FIFO fed with recorded reports).
+        HidRawDev(std::string const& _path);
+        ~HidRawDev();
+
+        // Find matching /dev/hidrawX file (or take the given path) and open it.
+        bool Open();
+        // Read single report.
+        // Returns number of bytes read, 0 if no report is available right now, -1 on error.
+        int Read(std::vector<char> & data);
+        bool Close();
+        bool IsOpen();
+        bool EnableGyro();
+        bool Write(std::vector<unsigned char> const& data);
+
+        // File descriptor of opened device (-1 if closed).
+        int GetFd();
+
+        // Path of opened device.
+        std::string const& GetPath();
+
+        private:
+        uint16_t vId;
+        uint16_t pId;
+        int interfaceNumber;
+        bool fixedPath;
+        int file;
+        std::string path;
+    };
+}
+
+#endif
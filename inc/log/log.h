@@ -3,6 +3,8 @@
 
 #include <string>
 #include <sstream>
+#include <optional>
+#include <cstdint>
 
 namespace kmicki::log
 {
@@ -20,13 +22,30 @@ namespace kmicki::log
 
     LogLevel const& GetLogLevel();
 
+    // Is a message of given level logged?
+    inline bool IsLogged(LogLevel type)
+    {
+        return type <= currentLogType;
+    }
+
     // Log a string message
+    // Message is queued in a lock-free queue of the calling thread and written by a background thread,
+    // so that logging never blocks the caller. If the queue is full, message is dropped (and counted).
+    // Messages are written to stdout, or to journald if SDGYRO_LOG_JOURNAL environment variable is set.
     void Log(std::string message,LogLevel type = LogLevelDefault);
 
+    // Wait until all messages queued so far are written.
+    void FlushLog();
+
+    // Number of messages dropped because the queue of the logging thread was full.
+    uint64_t GetDroppedLogCount();
+
     // class for logging formatted message
     // Behaves like output stream and message gets logged on destruction.
+    // Stream is created only if the message is logged at current level,
+    // otherwise values are not formatted at all.
     // Usage: { LogF() << "This is an example message number " << nr << "!"; }
-    class LogF : protected std::ostringstream
+    class LogF
     {
         public:
 
@@ -36,8 +55,8 @@ namespace kmicki::log
         template<class T>
         LogF& operator<<(T const& val)
         {
-            if(logType <= currentLogType)
-                *((std::ostringstream*)this) << val;            
+            if(stream)
+                *stream << val;
             return *this;
         }
 
@@ -46,7 +65,8 @@ namespace kmicki::log
 
         private:
         LogLevel logType;
+        std::optional<std::ostringstream> stream;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
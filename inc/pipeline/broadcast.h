@@ -0,0 +1,113 @@
+#ifndef _KMICKI_PIPELINE_BROADCAST_H_
+#define _KMICKI_PIPELINE_BROADCAST_H_
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+namespace kmicki::pipeline
+{
+    // Broadcast objects of type T from single writer to any number of readers.
+    // Ring of sequence-numbered slots (seqlocks): writer never waits for readers,
+    // readers take copies of objects without locking.
+    // Each reader gets every object as long as it is no more than depth objects behind.
+    // Readers detect missed objects from the sequence numbers.
+    // T's copy assignment must not reallocate between instances
+    // of the same shape (e.g. frames of constant length).
+    template<class T>
+    class Broadcast
+    {
+        public:
+        // Broadcast needs depth instances of T.
+        // Default constructor calls new T() without arguments
+        // to create them.
+        Broadcast(int depth = 1);
+
+        // This constructor allows to provide instance
+        // of T by pointer. Broadcast grabs ownership of it.
+        // Remaining slots and readers' copies are created from it.
+        Broadcast(T* inst, int depth = 1);
+        ~Broadcast();
+
+        // Methods to be used by writer:
+
+        // Copy object into the next slot and wake waiting readers.
+        void Publish(T const& object);
+
+        // Force readers' waits to continue.
+        void Flush();
+
+        int GetDepth();
+
+        // Reader of broadcasted objects.
+        // Each reader has its own copies of objects,
+        // to be used by a single thread.
+        class Reader
+        {
+            public:
+            Reader() = delete;
+            Reader(Broadcast<T> & _broadcast);
+            ~Reader();
+
+            // Get reference to unique_ptr to the copy of read object.
+            // index: position in the batch obtained by WaitForBatch()/TryBatch()
+            //        0 is the object read by WaitForData()/TryData()
+            std::unique_ptr<T> const& GetPointer(int index = 0);
+
+            // Wait for the oldest not yet read object and copy it.
+            // Returns false if woken up by Flush() without new object.
+            bool WaitForData();
+            // Wait for the oldest not yet read object with timeout.
+            // Returns true when data was obtained.
+            template<class R, class P>
+            bool WaitForData(std::chrono::duration<R,P> timeout);
+            // Copy the oldest not yet read object if there is one.
+            // Returns false if there's no new object.
+            bool TryData();
+
+            // Wait for new objects and copy all not yet read ones (oldest first).
+            // Returns number of copied objects (0 if woken up by Flush()).
+            int WaitForBatch();
+            // Copy all not yet read objects (oldest first).
+            // Returns number of copied objects.
+            int TryBatch();
+
+            // Number of objects that were overwritten without being read
+            // before the objects obtained by the most recent call.
+            uint32_t GetMissedCount();
+
+            private:
+            bool ReadNext(T & object);
+
+            Broadcast<T> & broadcast;
+            std::vector<std::unique_ptr<T>> objects;
+            uint32_t next;
+            uint32_t missed;
+        };
+
+        private:
+        struct Slot
+        {
+            std::unique_ptr<T> object;
+            // 2n+2 - contains n-th published object, 2n+1 - n-th object is being written.
+            std::atomic<uint32_t> sequence;
+        };
+
+        int depth;
+        std::unique_ptr<Slot[]> slots;
+
+        // Number of published objects.
+        std::atomic<uint32_t> published;
+        std::atomic<uint32_t> flushCount;
+        // Changed by every publish and flush.
+        // Futex word for readers waiting for next object.
+        std::atomic<uint32_t> wakeCount;
+        std::atomic<uint32_t> waitingReaders;
+    };
+}
+
+#include "broadcast.hpp"
+
+#endif
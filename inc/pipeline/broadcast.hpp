@@ -0,0 +1,194 @@
+#include "broadcast.h"
+#include "futex.h"
+
+namespace kmicki::pipeline
+{
+    // Definition - Broadcast
+
+    template<class T>
+    Broadcast<T>::Broadcast(int depth)
+    : Broadcast(new T(), depth)
+    { }
+
+    template<class T>
+    Broadcast<T>::Broadcast(T* inst, int _depth)
+    : depth(_depth < 1 ? 1 : _depth), slots(new Slot[_depth < 1 ? 1 : _depth]),
+      published(0), flushCount(0), wakeCount(0), waitingReaders(0)
+    {
+        slots[0].object.reset(inst);
+        slots[0].sequence.store(0,std::memory_order_relaxed);
+        for(int i = 1; i < depth; ++i)
+        {
+            slots[i].object.reset(new T(*inst));
+            slots[i].sequence.store(0,std::memory_order_relaxed);
+        }
+    }
+
+    template<class T>
+    Broadcast<T>::~Broadcast()
+    { }
+
+    template<class T>
+    int Broadcast<T>::GetDepth()
+    {
+        return depth;
+    }
+
+    template<class T>
+    void Broadcast<T>::Publish(T const& object)
+    {
+        auto n = published.load(std::memory_order_relaxed);
+        auto & slot = slots[n % depth];
+        slot.sequence.store(2*n+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        *slot.object = object;
+        slot.sequence.store(2*n+2,std::memory_order_release);
+        published.store(n+1);
+        wakeCount.fetch_add(1);
+        if(waitingReaders.load() > 0)
+            FutexWakeAll(wakeCount);
+    }
+
+    template<class T>
+    void Broadcast<T>::Flush()
+    {
+        flushCount.fetch_add(1);
+        wakeCount.fetch_add(1);
+        FutexWakeAll(wakeCount);
+    }
+
+    // Definition - Broadcast::Reader
+
+    template<class T>
+    Broadcast<T>::Reader::Reader(Broadcast<T> & _broadcast)
+    : broadcast(_broadcast), objects(), 
+      next(_broadcast.published.load()), missed(0)
+    { 
+        for(int i = 0; i < broadcast.depth; ++i)
+            objects.emplace_back(new T(*broadcast.slots[0].object));
+    }
+
+    template<class T>
+    Broadcast<T>::Reader::~Reader()
+    { }
+
+    template<class T>
+    std::unique_ptr<T> const& Broadcast<T>::Reader::GetPointer(int index)
+    {
+        return objects[index];
+    }
+
+    template<class T>
+    bool Broadcast<T>::Reader::ReadNext(T & object)
+    {
+        while(true)
+        {
+            auto count = broadcast.published.load(std::memory_order_acquire);
+            if(count == next)
+                return false;
+            if(count - next > (uint32_t)broadcast.depth)
+            {
+                // Fell behind more than the whole ring
+                missed += count - next - broadcast.depth;
+                next = count - broadcast.depth;
+            }
+
+            auto & slot = broadcast.slots[next % broadcast.depth];
+            auto expected = 2*next+2;
+            if(slot.sequence.load(std::memory_order_acquire) == expected)
+            {
+                object = *slot.object;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(slot.sequence.load(std::memory_order_relaxed) == expected)
+                {
+                    ++next;
+                    return true;
+                }
+            }
+
+            // Overwritten before or during the copy
+            ++missed;
+            ++next;
+        }
+    }
+
+    template<class T>
+    bool Broadcast<T>::Reader::TryData()
+    {
+        missed = 0;
+        return ReadNext(*objects[0]);
+    }
+
+    template<class T>
+    bool Broadcast<T>::Reader::WaitForData()
+    {
+        missed = 0;
+        auto flush = broadcast.flushCount.load();
+        while(true)
+        {
+            // wake count is taken before checking for data and flush,
+            // so that a publish or flush after the check ends the wait
+            auto wake = broadcast.wakeCount.load();
+            if(ReadNext(*objects[0]))
+                return true;
+            if(broadcast.flushCount.load() != flush)
+                return false;
+            broadcast.waitingReaders.fetch_add(1);
+            FutexWait(broadcast.wakeCount,wake);
+            broadcast.waitingReaders.fetch_sub(1);
+        }
+    }
+
+    template<class T>
+    template<class R, class P>
+    bool Broadcast<T>::Reader::WaitForData(std::chrono::duration<R,P> timeout)
+    {
+        missed = 0;
+        auto flush = broadcast.flushCount.load();
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while(true)
+        {
+            auto wake = broadcast.wakeCount.load();
+            if(ReadNext(*objects[0]))
+                return true;
+            auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+            if(left.count() <= 0 || broadcast.flushCount.load() != flush)
+                return false;
+            broadcast.waitingReaders.fetch_add(1);
+            FutexWait(broadcast.wakeCount,wake,left);
+            broadcast.waitingReaders.fetch_sub(1);
+        }
+    }
+
+    template<class T>
+    int Broadcast<T>::Reader::TryBatch()
+    {
+        missed = 0;
+        int count = 0;
+        while(count < broadcast.depth && ReadNext(*objects[count]))
+            ++count;
+        return count;
+    }
+
+    template<class T>
+    int Broadcast<T>::Reader::WaitForBatch()
+    {
+        auto flush = broadcast.flushCount.load();
+        while(true)
+        {
+            auto wake = broadcast.wakeCount.load();
+            int count = TryBatch();
+            if(count > 0 || broadcast.flushCount.load() != flush)
+                return count;
+            broadcast.waitingReaders.fetch_add(1);
+            FutexWait(broadcast.wakeCount,wake);
+            broadcast.waitingReaders.fetch_sub(1);
+        }
+    }
+
+    template<class T>
+    uint32_t Broadcast<T>::Reader::GetMissedCount()
+    {
+        return missed;
+    }
+}
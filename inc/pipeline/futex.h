@@ -0,0 +1,27 @@
+#ifndef _KMICKI_PIPELINE_FUTEX_H_
+#define _KMICKI_PIPELINE_FUTEX_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace kmicki::pipeline
+{
+    // Thin wrappers over futex(2) on a 32-bit atomic word.
+    // Used to block only when there really is nothing to do, instead of
+    // going through a mutex/condition variable pair on every hand-off.
+
+    // Block while word == expected.
+    // Returns false if timeout elapsed, true otherwise (woken up, value changed or spurious wake).
+    bool FutexWait(std::atomic<uint32_t> & word, uint32_t expected);
+    bool FutexWait(std::atomic<uint32_t> & word, uint32_t expected, std::chrono::nanoseconds timeout);
+
+    // Wake up to count threads blocked in FutexWait on word.
+    void FutexWake(std::atomic<uint32_t> & word, int count = 1);
+    void FutexWakeAll(std::atomic<uint32_t> & word);
+
+    // Wake all threads of any process blocked on word in memory shared between processes.
+    void FutexWakeAllShared(uint32_t * word);
+}
+
+#endif
@@ -3,11 +3,16 @@
 
 #include <memory>
 #include <chrono>
+#include <atomic>
+#include <cstdint>
 
 namespace kmicki::pipeline
 {
     // For sending pipelined object to the next thread in pipeline
     // With triple buffering (T - object's type)
+    // Single producer, single consumer. Lock-free: buffers are swapped
+    // through one atomic word, consumer blocks on a futex only
+    // when there is no data waiting.
     template<class T>
     class PipeOut
     {
@@ -54,13 +59,20 @@ namespace kmicki::pipeline
         bool TryData();
 
         // Force the wait to continue.
+        // May be called from any thread.
         void Flush();
 
         private:
-        std::unique_ptr<T> bufMod,bufSent,bufRcv;
-        std::mutex bufSentMutex;
-        std::condition_variable bufSentConditionVariable;
-        bool bufWasSent;
+        // Lowest bit of the middle buffer's address marks it as not received yet.
+        static constexpr uintptr_t cFresh = 1;
+        static_assert(alignof(T) > 1, "PipeOut uses lowest bit of T's address as a flag.");
+
+        void WakeReceiver();
+
+        std::unique_ptr<T> bufMod;
+        std::atomic<uintptr_t> bufSent;
+        std::unique_ptr<T> bufRcv;
+        std::atomic<uint32_t> receiverWaiting;
     };
 }
 
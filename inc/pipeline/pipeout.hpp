@@ -1,4 +1,5 @@
 #include "pipeout.h"
+#include "futex.h"
 
 namespace kmicki::pipeline
 {
@@ -12,14 +13,15 @@ namespace kmicki::pipeline
 
     template<class T>
     PipeOut<T>::PipeOut(T* inst1, T* inst2, T* inst3)
-    : bufMod(inst1),bufSent(inst2),bufRcv(inst3),
-      bufSentMutex(), bufSentConditionVariable(),
-      bufWasSent(false)
+    : bufMod(inst1),bufSent(reinterpret_cast<uintptr_t>(inst2)),bufRcv(inst3),
+      receiverWaiting(0)
     { }
 
     template<class T>
     PipeOut<T>::~PipeOut()
-    { }
+    {
+        delete reinterpret_cast<T*>(bufSent.load() & ~cFresh);
+    }
 
     template<class T>
     T & PipeOut<T>::GetDataToFill()
@@ -36,19 +38,15 @@ namespace kmicki::pipeline
     template<class T>
     void PipeOut<T>::SendData()
     {
-        {
-            std::lock_guard lock(bufSentMutex);
-            bufSent.swap(bufMod);
-            bufWasSent = true;
-        }
-        bufSentConditionVariable.notify_all();
+        auto sent = bufSent.exchange(reinterpret_cast<uintptr_t>(bufMod.release()) | cFresh);
+        bufMod.reset(reinterpret_cast<T*>(sent & ~cFresh));
+        WakeReceiver();
     }
 
     template<class T>
     bool PipeOut<T>::WasReceived()
     {
-        std::lock_guard lock(bufSentMutex);
-        return !bufWasSent;
+        return (bufSent.load(std::memory_order_relaxed) & cFresh) == 0;
     }
 
     template<class T>
@@ -67,47 +65,67 @@ namespace kmicki::pipeline
     template<class T>
     void PipeOut<T>::WaitForData()
     {
-        std::unique_lock lock(bufSentMutex);
-        bufSentConditionVariable.wait(lock,[&] { return bufWasSent; });
-        bufSent.swap(bufRcv);
-        bufWasSent = false;
+        while(!TryData())
+        {
+            receiverWaiting.store(1);
+            if(TryData())
+                break;
+            FutexWait(receiverWaiting,1);
+        }
+        receiverWaiting.store(0,std::memory_order_relaxed);
     }
 
     template<class T>
     template<class R,class P>
     bool PipeOut<T>::WaitForData(std::chrono::duration<R,P> timeout)
     {
-        std::unique_lock lock(bufSentMutex);
-        if(bufSentConditionVariable.wait_for(lock,timeout,[&](){ return bufWasSent; }))
-        {
-            bufSent.swap(bufRcv);
-            bufWasSent = false;
+        if(TryData())
             return true;
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        bool result = false;
+        while(true)
+        {
+            receiverWaiting.store(1);
+            if((result = TryData()))
+                break;
+            auto left = deadline - std::chrono::steady_clock::now();
+            if(!FutexWait(receiverWaiting,1,std::chrono::duration_cast<std::chrono::nanoseconds>(left)))
+            {
+                result = TryData();
+                break;
+            }
         }
-        return false;
+        receiverWaiting.store(0,std::memory_order_relaxed);
+        return result;
     }
 
     template<class T>
     bool PipeOut<T>::TryData()
     {
-        std::lock_guard lock(bufSentMutex);
-        if(bufWasSent)
-        {
-            bufSent.swap(bufRcv);
-            bufWasSent = false;
-            return true;
-        }
-        return false;
+        if((bufSent.load() & cFresh) == 0)
+            return false;
+        // Only producer may touch the word in the meantime
+        // and it can only replace it with another fresh buffer.
+        auto sent = bufSent.exchange(reinterpret_cast<uintptr_t>(bufRcv.release()));
+        bufRcv.reset(reinterpret_cast<T*>(sent & ~cFresh));
+        return true;
     }
 
     template<class T>
     void PipeOut<T>::Flush()
     {
-        {
-            std::lock_guard lock(bufSentMutex);
-            bufWasSent = true;
-        }
-        bufSentConditionVariable.notify_all();
+        bufSent.fetch_or(cFresh);
+        WakeReceiver();
+    }
+
+    template<class T>
+    void PipeOut<T>::WakeReceiver()
+    {
+        // Pairs with receiverWaiting.store(1) followed by TryData() in WaitForData().
+        // Either the receiver sees fresh data or the sender sees it waiting.
+        if(receiverWaiting.load() != 0 && receiverWaiting.exchange(0) != 0)
+            FutexWake(receiverWaiting);
     }
 
-}
\ No newline at end of file
+}
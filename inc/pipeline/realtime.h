@@ -0,0 +1,35 @@
+#ifndef _KMICKI_PIPELINE_REALTIME_H_
+#define _KMICKI_PIPELINE_REALTIME_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <sched.h>
+
+namespace kmicki::pipeline
+{
+    // Scheduling settings of a thread.
+    // Default-constructed profile keeps all defaults.
+    struct RealtimeProfile
+    {
+        int policy = SCHED_OTHER;           // SCHED_FIFO/SCHED_RR for real-time, SCHED_OTHER keeps default
+        int priority = 0;                   // real-time priority (1-99)
+        std::vector<int> cpus;              // CPUs to pin the thread to, empty - no pinning
+        unsigned long timerSlackNs = 0;     // timer slack, 0 - keep default
+        size_t prefaultStackBytes = 0;      // stack to prefault and lock, 0 - none
+
+        bool IsDefault() const;
+    };
+
+    // Apply profile to the calling thread and name it.
+    // Settings that fail (e.g. missing privileges) are skipped.
+    // Logs which settings took effect.
+    // Returns true if all settings took effect.
+    bool ApplyRealtimeProfile(std::string const& threadName, RealtimeProfile const& profile);
+
+    // Lock all memory currently mapped by the process, so that it's never paged out.
+    // Logs the result. Returns true if successful.
+    bool LockMemory();
+}
+
+#endif
@@ -1,12 +1,19 @@
 #ifndef _KMICKI_PIPELINE_THREAD_H_
 #define _KMICKI_PIPELINE_THREAD_H_
 
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <thread>
+#include <string>
+
+#include "realtime.h"
 
 namespace kmicki::pipeline
 {
     // Represents single thread in the pipeline
+    // Stopping and restarting is cooperative: Execute() is asked
+    // to return by ShouldContinue() and blocking waits are woken up
+    // through FlushPipes() and the wake file descriptor.
     class Thread
     {
         public:
@@ -14,26 +21,18 @@ namespace kmicki::pipeline
         ~Thread();
         // Start the thread.
         void Start();
-        // Stop the thread.
+        // Stop the thread. Waits until Execute() returns.
         void Stop();
-        // Kill the thread.
-        void Kill();
         // Restart the thread.
+        // Interrupts Execute() and runs it again on the same thread.
+        // Does not wait. Starts the thread if it is not running.
         void Restart();
-        // Kill and restart.
-        void ForceRestart();
-        // Kill if stopping fails.
-        template<class R, class P>
-        void TryStopThenKill(std::chrono::duration<R,P> timeout);
-        void TryStopThenKill();
-        // Force restart if normal restart fails.
-        template<class R, class P>
-        void TryRestartThenForceRestart(std::chrono::duration<R,P> timeout);
-        void TryRestartThenForceRestart();
         // Check if the thread is running.
         bool IsStarted();
         // Check if the thread is trying to stop
         bool IsStopping();
+        // Set name and scheduling profile applied when the thread starts.
+        void SetRealtimeProfile(std::string const& _name, RealtimeProfile const& profile);
 
         protected:
         // Method that executes on the thread.
@@ -43,17 +42,25 @@ namespace kmicki::pipeline
         bool ShouldContinue();
         // Force thread to continue through all waits on other pipeline threads
         virtual void FlushPipes() = 0;
+        // File descriptor that becomes readable when the thread is asked
+        // to stop or restart. Include it in poll sets of blocking reads.
+        int GetWakeFd();
 
         private:
+        void Run();
+        void Wake();
+        void ClearWake();
+
+        static const uint32_t cStateStop;
+        static const uint32_t cStateRestart;
+
         std::unique_ptr<std::thread> executeThread;
-        std::thread::native_handle_type threadHandle;
-        std::mutex stopMutex;
-        bool stop;
+        std::atomic<uint32_t> state;
+        int wakeFd;
 
-        static const std::chrono::milliseconds cTimeout;
+        std::string name;
+        RealtimeProfile realtimeProfile;
     };
 }
 
-#include "thread.hpp"
-
-#endif
\ No newline at end of file
+#endif
@@ -2,18 +2,25 @@
 #define _KMICKI_SDGYRODSU_CEMUHOOKADAPTER_H_
 
 #include "sdhidframe.h"
+#include "clockrecovery.h"
 #include "cemuhook/cemuhookprotocol.h"
 #include "hiddev/hiddevreader.h"
-#include "pipeline/serve.h"
 #include "pipeline/signalout.h"
 
 namespace kmicki::sdgyrodsu
 {
+    // Smooth accelerometer axis: small changes are filtered, large ones are taken as they are.
+    // last: filtered value of the axis (updated). Returns filtered value in G.
+    float SmoothAccel(float &last, int16_t curr);
+
     class CemuhookAdapter
     {
         public:
-        CemuhookAdapter() = delete;
+        // Adapter without reader. Frames are provided by caller (see SetMotionDataFromFrame).
+        // Start/StopFrameGrab only reset the state then.
+        CemuhookAdapter(bool persistent = true);
 
+        // Adapter pulling frames from the reader (see SetMotionDataNewFrame).
         CemuhookAdapter(hiddev::HidDevReader & _reader, bool persistent = true);
 
         void StartFrameGrab();
@@ -24,11 +31,31 @@ namespace kmicki::sdgyrodsu
         int const& SetMotionDataNewFrame(cemuhook::protocol::MotionData &motion);
         void StopFrameGrab();
 
+        // Modifies motion data in place using provided frame (adapter without reader).
+        // Returns false if the frame is a repetition of the last one and was ignored.
+        // If frames were missed, GetToReplicate returns number of frames to be replicated
+        // next with SetMotionDataReplicated.
+        bool SetMotionDataFromFrame(frame_t const& frame, cemuhook::protocol::MotionData &motion);
+
+        // Modifies motion data in place as a next replicated frame.
+        // Returns number of frames still to be replicated.
+        int const& SetMotionDataReplicated(cemuhook::protocol::MotionData &motion);
+
+        // Number of frames to be replicated.
+        int const& GetToReplicate();
+
         bool IsControllerConnected();
 
+        // Increment (frame counter) of the last frame that motion data was set from.
+        uint32_t const& GetLastIncrement();
+
         cemuhook::protocol::MotionData GetMotionData(SdHidFrame const& frame, float &lastAccelRtL, float &lastAccelFtB, float &lastAccelTtB);
         static void SetMotionData(SdHidFrame const& frame, cemuhook::protocol::MotionData &data, float &lastAccelRtL, float &lastAccelFtB, float &lastAccelTtB);
 
+        // Report missing gyro data through given signal instead of NoGyro,
+        // so that all adapters of one reader share the signal the reader listens to.
+        void SetNoGyro(SignalOut & signal);
+
         SignalOut NoGyro;
 
         private:
@@ -36,19 +63,32 @@ namespace kmicki::sdgyrodsu
         bool isPersistent;
 
         cemuhook::protocol::MotionData data;
-        hiddev::HidDevReader & reader;
+        hiddev::HidDevReader * reader;
 
         uint32_t lastInc;
         uint64_t lastTimestamp;
+        uint64_t periodUs;
+
+        // Timing of frames recovered from host timestamps
+        ClockRecovery clock;
         
         float lastAccelRtL;
         float lastAccelFtB;
         float lastAccelTtB;
 
         int toReplicate;
+
+        // Frames obtained from the serve in one batch and not used yet
+        int batchSize;
+        int batchPos;
         int noGyroCooldown;
 
-        pipeline::Serve<hiddev::HidDevReader::frame_t> * frameServe;
+        hiddev::HidDevReader::serve_t * frameServe;
+        SignalOut * noGyro;
+
+        // Use frame for motion data. Returns false if frame was repeated.
+        // hostTimestamp: host time when frame was read (ns), 0 if unknown
+        bool UseFrame(SdHidFrame const& frame, uint64_t const& hostTimestamp, cemuhook::protocol::MotionData &motion);
     };
 }
 
@@ -0,0 +1,50 @@
+#ifndef _KMICKI_SDGYRODSU_CLOCKRECOVERY_H_
+#define _KMICKI_SDGYRODSU_CLOCKRECOVERY_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace kmicki::sdgyrodsu
+{
+    // Recovers timing of the device's frames from host times when they were read.
+    // Fits a line (host time against frame counter) over recent frames,
+    // so that frame times follow the actual rate of the device without the jitter of reading.
+    class ClockRecovery
+    {
+        public:
+        ClockRecovery() = delete;
+        // nominalPeriodNs: period assumed until it's measured
+        ClockRecovery(uint64_t const& nominalPeriodNs);
+
+        // Forget all frames.
+        void Reset();
+
+        // Add frame with its counter and host time (CLOCK_MONOTONIC, ns) when it was read.
+        // Returns smoothed time of the frame in ns.
+        uint64_t Update(uint32_t const& increment, uint64_t const& hostTimeNs);
+
+        // Estimated period between frames in ns.
+        double const& GetPeriodNs() const;
+
+        private:
+        struct Sample
+        {
+            int64_t counter;    // frame counter without wraparound
+            uint64_t time;      // host time in ns
+        };
+
+        uint64_t nominalPeriod;
+
+        std::vector<Sample> samples;    // ring of recent frames
+        int count;
+        int pos;
+
+        int64_t counter;
+        uint32_t lastIncrement;
+        uint64_t lastTime;
+        uint64_t lastOutput;
+        double period;
+    };
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _KMICKI_SDGYRODSU_METRICSSERVER_H_
+#define _KMICKI_SDGYRODSU_METRICSSERVER_H_
+
+#include "cemuhook/cemuhookserver.h"
+#include "stats/stats.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
+
+namespace kmicki::sdgyrodsu
+{
+    // Serves statistics of the pipeline and the DSU server in Prometheus text format over HTTP.
+    // Listens only locally: on a UNIX socket or on a loopback TCP port.
+    // Scrapes are handled one at a time by own thread, away from the data path.
+    class MetricsServer
+    {
+        public:
+        MetricsServer() = delete;
+
+        // address: path of UNIX socket (starting with '/') or TCP port on 127.0.0.1.
+        // server: DSU server whose clients are reported.
+        MetricsServer(std::string const& address, cemuhook::Server & server);
+
+        // Stop serving and remove UNIX socket.
+        ~MetricsServer();
+
+        // Text of all metrics. Only totals are exposed (no per-scrape state),
+        // rates are left to the scraper, so that any number of scrapers can be used.
+        std::string GetMetrics();
+
+        private:
+        cemuhook::Server & server;
+        std::string unixPath;
+        int socketFd;
+        std::atomic<bool> stop;
+        std::unique_ptr<std::thread> thread;
+
+        void serverTask();
+
+        // Read request from a connection and send response.
+        void HandleConnection(int const& connectionFd);
+    };
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef _KMICKI_SDGYRODSU_REACTOR_H_
+#define _KMICKI_SDGYRODSU_REACTOR_H_
+
+#include "cemuhookadapter.h"
+#include "cemuhook/cemuhookserver.h"
+#include "hiddev/hidrawdev.h"
+
+#ifdef SDGYRO_IO_URING
+#include <liburing.h>
+#include <memory>
+#endif
+
+namespace kmicki::sdgyrodsu
+{
+    // Single-threaded runtime.
+    // One epoll loop reads HID reports from hidraw device, converts them to motion data
+    // and sends them to subscribed clients in the same iteration.
+    // The same loop handles client requests, client timeouts (timerfd)
+    // and SIGINT/SIGTERM/SIGUSR1 (signalfd).
+    // With io_uring (built with SDGYRO_IO_URING) the loop waits on completions instead:
+    // HID reports come from a multishot read and packets for all clients of a frame
+    // are submitted together with the next wait.
+    class Reactor
+    {
+        public:
+        Reactor() = delete;
+
+        // vId: vendor ID
+        // pId: product ID
+        // interfaceNumber: interface number of the device
+        // frameLen: size of single HID report
+        // startMarker: beginning of every valid report
+        // ioUring: use io_uring instead of epoll (ignored if built without SDGYRO_IO_URING)
+        Reactor(uint16_t const& vId, uint16_t const& pId, int const& interfaceNumber, int const& frameLen, std::vector<char> const& startMarker, bool const& ioUring = false);
+        // devicePath: file providing HID reports instead of hidraw device (e.g. FIFO in benchmark)
+        Reactor(std::string const& devicePath, int const& frameLen, std::vector<char> const& startMarker, bool const& ioUring = false);
+        ~Reactor();
+
+        // Run the loop until SIGINT or SIGTERM.
+        // Handled signals are blocked for the calling thread,
+        // so it has to be called from the main thread before other threads are created.
+        void Run();
+
+        private:
+        hiddev::HidRawDev device;
+        CemuhookAdapter adapter;
+        cemuhook::Server server;
+
+        frame_t frame;
+        std::vector<char> startMarker;
+        cemuhook::protocol::MotionData motion;
+
+        int epollFd;
+        int timerFd;
+        int signalFd;
+
+        bool stop;
+        bool sending;
+        bool ioUring;
+
+        void Init();
+        void OpenDevice();
+        void CloseDevice();
+        void HandleDevice();
+        void HandleFrame();
+        void HandleTimer();
+        void HandleSignal();
+
+        void Watch(int fd);
+
+#ifdef SDGYRO_IO_URING
+        // io_uring loop (reactoruring.cpp)
+
+        // Packet queued for sending to a client. Kept until its completion.
+        struct Send
+        {
+            std::vector<char> data;
+            sockaddr_in address;
+            iovec vec;
+            msghdr message;
+        };
+
+        io_uring ring;
+        io_uring_buf_ring * readBuffers;    // buffers provided to HID read
+        std::vector<char> readBufferData;
+        bool readMultishot;                 // false if kernel doesn't support multishot read
+        bool readArmed;
+        io_uring_sqe * lastSend;            // last send of current frame (ends the link)
+        std::vector<std::unique_ptr<Send>> sends;
+        std::vector<Send*> freeSends;
+        std::vector<io_uring_cqe> completions;  // reaped, not handled yet
+
+        void InitUring();
+        void RunUring();
+        void CloseUring();
+        void ArmRead();
+        void CancelRead();
+        void ArmPoll(int fd, uint64_t tag);
+        void QueueSend(iovec const* vecs, int const& count, sockaddr_in const& address);
+        void HandleRead(io_uring_cqe const* cqe);
+        void HandleCompletion(io_uring_cqe const& cqe);
+        unsigned ReapCompletions();
+        io_uring_sqe * GetSqe();
+#endif
+    };
+}
+
+#endif
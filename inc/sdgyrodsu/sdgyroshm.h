@@ -0,0 +1,211 @@
+/*
+ * Shared memory of SteamDeckGyroDSU: motion data and raw HID frames for local consumers.
+ *
+ * Published when the server runs with SDGYRO_SHM set. Shared memory object "/sdgyrodsu"
+ * (/dev/shm/sdgyrodsu) holds a ring of records for each controller slot.
+ * Records are read without locks and without system calls: every record has a sequence number
+ * (seqlock) that tells which record it holds and whether it is being written.
+ * Readers that want to block until the next record wait on a futex.
+ *
+ * Header-only C reader:
+ *
+ *     struct sdgyro_shm_reader reader;
+ *     struct sdgyro_shm_record record;
+ *     if(sdgyro_shm_open(&reader,0) == 0)
+ *         while(sdgyro_shm_wait(&reader,&record,1000) >= 0)
+ *             ... record.motion, record.frame ...
+ *     sdgyro_shm_close(&reader);
+ */
+
+#ifndef _KMICKI_SDGYRODSU_SDGYROSHM_H_
+#define _KMICKI_SDGYRODSU_SDGYROSHM_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SDGYRO_SHM_NAME "/sdgyrodsu"
+#define SDGYRO_SHM_MAGIC 0x4D485344u    /* "DSHM" */
+#define SDGYRO_SHM_VERSION 1
+#define SDGYRO_SHM_SLOTS 4              /* controller slots, as in DSU */
+#define SDGYRO_SHM_DEPTH 64             /* records in the ring of a slot (power of 2) */
+#define SDGYRO_SHM_FRAME_LEN 64         /* max length of raw HID frame */
+
+/* Motion data as sent over DSU. */
+struct sdgyro_shm_motion
+{
+    uint64_t timestamp_us;      /* timestamp of the sample (us) */
+    float acc_x, acc_y, acc_z;  /* acceleration (g) */
+    float pitch, yaw, roll;     /* angular velocity (deg/s) */
+};
+
+struct sdgyro_shm_record
+{
+    uint32_t sequence;          /* 2n+2 - holds n-th record of the slot, odd - being written */
+    uint32_t increment;         /* frame counter of the controller */
+    uint64_t host_time_ns;      /* CLOCK_MONOTONIC time when the frame was read (ns) */
+    struct sdgyro_shm_motion motion;
+    uint32_t frame_len;         /* valid bytes in frame */
+    uint32_t reserved;
+    unsigned char frame[SDGYRO_SHM_FRAME_LEN];  /* raw HID frame (Steam Deck Controls' report) */
+};
+
+struct sdgyro_shm_slot
+{
+    uint32_t published;         /* number of published records, futex word of waiting readers */
+    uint32_t waiters;           /* number of readers waiting on the futex */
+    uint32_t active;            /* 1 - slot has a controller */
+    uint32_t reserved;
+    struct sdgyro_shm_record records[SDGYRO_SHM_DEPTH];
+};
+
+struct sdgyro_shm
+{
+    uint32_t magic;             /* SDGYRO_SHM_MAGIC when initialized */
+    uint32_t version;           /* SDGYRO_SHM_VERSION */
+    uint32_t slot_count;        /* SDGYRO_SHM_SLOTS */
+    uint32_t depth;             /* SDGYRO_SHM_DEPTH */
+    uint32_t record_size;       /* sizeof(struct sdgyro_shm_record) */
+    uint32_t publisher_pid;
+    uint32_t reserved[2];
+    struct sdgyro_shm_slot slots[SDGYRO_SHM_SLOTS];
+};
+
+/* Reader of one slot. */
+struct sdgyro_shm_reader
+{
+    struct sdgyro_shm * shm;
+    struct sdgyro_shm_slot * slot;
+    uint32_t next;              /* number of the next record to read */
+    uint32_t missed;            /* records overwritten before they were read (total) */
+};
+
+/* Map shared memory and start reading given slot from its newest record.
+   Returns 0 or -errno. */
+static inline int sdgyro_shm_open(struct sdgyro_shm_reader * reader, int slot)
+{
+    int fd;
+    void * map;
+
+    memset(reader,0,sizeof(*reader));
+    if(slot < 0 || slot >= SDGYRO_SHM_SLOTS)
+        return -EINVAL;
+
+    fd = shm_open(SDGYRO_SHM_NAME,O_RDWR,0);
+    if(fd < 0)
+        return -errno;
+    /* waiters counter is written by readers */
+    map = mmap(NULL,sizeof(struct sdgyro_shm),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return -errno;
+
+    reader->shm = (struct sdgyro_shm *)map;
+    if(__atomic_load_n(&reader->shm->magic,__ATOMIC_ACQUIRE) != SDGYRO_SHM_MAGIC
+       || reader->shm->version != SDGYRO_SHM_VERSION
+       || reader->shm->record_size != sizeof(struct sdgyro_shm_record))
+    {
+        munmap(map,sizeof(struct sdgyro_shm));
+        reader->shm = NULL;
+        return -EPROTO;
+    }
+
+    reader->slot = &reader->shm->slots[slot];
+    reader->next = __atomic_load_n(&reader->slot->published,__ATOMIC_ACQUIRE);
+    if(reader->next > 0)
+        --reader->next;
+    return 0;
+}
+
+static inline void sdgyro_shm_close(struct sdgyro_shm_reader * reader)
+{
+    if(reader->shm != NULL)
+        munmap(reader->shm,sizeof(struct sdgyro_shm));
+    reader->shm = NULL;
+    reader->slot = NULL;
+}
+
+/* Copy the oldest not yet read record without blocking.
+   Returns 1 if a record was copied, 0 if there's no new record. */
+static inline int sdgyro_shm_try(struct sdgyro_shm_reader * reader, struct sdgyro_shm_record * record)
+{
+    for(;;)
+    {
+        uint32_t published = __atomic_load_n(&reader->slot->published,__ATOMIC_ACQUIRE);
+        const struct sdgyro_shm_record * source;
+        uint32_t expected, before, after;
+
+        if(published == reader->next)
+            return 0;
+        if(published - reader->next > SDGYRO_SHM_DEPTH)
+        {
+            /* reader is too far behind, continue from the oldest record still in the ring */
+            reader->missed += published - reader->next - SDGYRO_SHM_DEPTH;
+            reader->next = published - SDGYRO_SHM_DEPTH;
+        }
+
+        source = &reader->slot->records[reader->next % SDGYRO_SHM_DEPTH];
+        expected = 2*reader->next+2;
+
+        before = __atomic_load_n(&source->sequence,__ATOMIC_ACQUIRE);
+        if(before == expected)
+        {
+            memcpy(record,source,sizeof(*record));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            after = __atomic_load_n(&source->sequence,__ATOMIC_RELAXED);
+            if(after == expected)
+            {
+                ++reader->next;
+                return 1;
+            }
+        }
+        else if((int32_t)(before - expected) < 0)
+            return 0;   /* not written yet */
+        else
+        {
+            /* record was overwritten before it was read: skip it */
+            ++reader->next;
+            ++reader->missed;
+        }
+    }
+}
+
+/* Wait for the next record and copy it.
+   timeout_ms: < 0 - no timeout.
+   Returns 1 if a record was copied, 0 on timeout. */
+static inline int sdgyro_shm_wait(struct sdgyro_shm_reader * reader, struct sdgyro_shm_record * record, int timeout_ms)
+{
+    struct timespec timeout;
+    int result;
+
+    result = sdgyro_shm_try(reader,record);
+    if(result != 0)
+        return result;
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+    __atomic_add_fetch(&reader->slot->waiters,1,__ATOMIC_SEQ_CST);
+    for(;;)
+    {
+        uint32_t published = __atomic_load_n(&reader->slot->published,__ATOMIC_SEQ_CST);
+        if(published != reader->next)
+            break;
+        /* shared futex: publisher is another process */
+        if(syscall(SYS_futex,&reader->slot->published,FUTEX_WAIT,published,timeout_ms < 0 ? NULL : &timeout,NULL,0) < 0
+           && errno == ETIMEDOUT)
+            break;
+    }
+    __atomic_sub_fetch(&reader->slot->waiters,1,__ATOMIC_SEQ_CST);
+
+    return sdgyro_shm_try(reader,record);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _KMICKI_SDGYRODSU_SHMPUBLISHER_H_
+#define _KMICKI_SDGYRODSU_SHMPUBLISHER_H_
+
+#include "sdgyroshm.h"
+#include "cemuhookadapter.h"
+#include "hiddev/hiddevreader.h"
+#include "pipeline/realtime.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+namespace kmicki::sdgyrodsu
+{
+    // Publishes motion data and raw frames of controllers into shared memory
+    // for consumers running on the same device (see sdgyroshm.h).
+    // Each slot is published by its own thread, independently of DSU clients.
+    class ShmPublisher
+    {
+        public:
+        ShmPublisher() = delete;
+
+        // Create shared memory and start publishing.
+        // readers: reader of each slot (index is slot number, nullptr - no controller).
+        // noGyro: signal of each slot that its reader listens to for missing gyro data
+        //         (shared with the DSU adapter of the slot, nullptr - none).
+        // profile: scheduling profile of publishing threads.
+        ShmPublisher(std::vector<hiddev::HidDevReader*> const& readers,
+                     std::vector<SignalOut*> const& noGyro,
+                     pipeline::RealtimeProfile const& profile = pipeline::RealtimeProfile());
+
+        // Stop publishing and remove shared memory.
+        ~ShmPublisher();
+
+        private:
+        struct Slot
+        {
+            hiddev::HidDevReader * reader;
+            std::unique_ptr<CemuhookAdapter> adapter;
+            std::unique_ptr<std::thread> thread;
+        };
+
+        sdgyro_shm * shm;
+        std::vector<Slot> slots;
+        pipeline::RealtimeProfile profile;
+        std::atomic<bool> stop;
+
+        void publishTask(int slotNo);
+
+        // Write record into the ring of a slot and wake waiting readers.
+        void Publish(int const& slotNo, frame_t const& frame, cemuhook::protocol::MotionData const& motion);
+    };
+}
+
+#endif
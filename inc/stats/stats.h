@@ -0,0 +1,92 @@
+#ifndef _KMICKI_STATS_STATS_H_
+#define _KMICKI_STATS_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace kmicki::stats
+{
+    // Counted events, prefixed with the stage of the pipeline where they happen.
+    // Counters of all controller slots are summed up. Serve and adapter counters
+    // also sum up all consumers of a slot (DSU server and shared memory publisher).
+    enum Counter
+    {
+        CounterReadFrames           = 0,    // frames read from device
+        CounterReadDropped          = 1,    // read frames overwritten before being processed
+        CounterReadUnsynced         = 2,    // incomplete reads or reads starting in the middle of a frame
+        CounterReadGyroEnable       = 3,    // attempts to reenable gyro after it stopped reporting
+        CounterReadGyroEnableFailed = 4,    // failed attempts to reenable gyro
+        CounterProcessFrames        = 5,    // hiddev records processed into frames
+        CounterProcessDropped       = 6,    // processed frames overwritten before being served
+        CounterServeOverrun         = 7,    // served frames overwritten before a consumer read them
+        CounterAdapterFrames        = 8,    // frames converted to motion data
+        CounterAdapterMissed        = 9,    // frames missing in the sequence of increments
+        CounterAdapterReplicated    = 10,   // motion samples replicated in place of missed frames
+        CounterAdapterRepeated      = 11,   // repeated frames that were ignored
+        CounterServerPackets        = 12,   // data packets sent to clients
+        CounterServerSendFailed     = 13,   // data packets that failed to be sent
+        CounterServerClientsAdded   = 14,   // clients that subscribed for data
+        CounterServerClientsTimedOut= 15,   // clients removed after no request for some time
+        CounterCount                = 16
+    };
+
+    namespace detail
+    {
+        // Each counter in its own cache line, so that threads of different stages don't contend.
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t> value;
+        };
+
+        extern Slot counters[CounterCount];
+    }
+
+    // Values of all counters at one moment.
+    struct Snapshot
+    {
+        uint64_t timeNs;                    // monotonic time of the snapshot
+        uint64_t values[CounterCount];
+
+        uint64_t const& operator[](Counter counter) const
+        {
+            return values[counter];
+        }
+    };
+
+    // Increase counter. Lock-free, no allocation.
+    inline void Add(Counter counter, uint64_t count = 1)
+    {
+        detail::counters[counter].value.fetch_add(count,std::memory_order_relaxed);
+    }
+
+    // Get current value of a counter.
+    inline uint64_t Get(Counter counter)
+    {
+        return detail::counters[counter].value.load(std::memory_order_relaxed);
+    }
+
+    Snapshot GetSnapshot();
+
+    // Name of a counter (lowercase, words separated by underscore), e.g. "read_dropped".
+    char const* GetName(Counter counter);
+
+    // Description of a counter.
+    char const* GetDescription(Counter counter);
+
+    // Set period of the summary logged by Tick(). Zero disables periodic summary.
+    void SetSummaryPeriod(std::chrono::seconds period);
+
+    // Log summary if summary period elapsed since the previous one.
+    // Has to be called regularly (period of the calls is the precision of the summary period).
+    void Tick();
+
+    // Log changes of counters since the previous summary and loss rates of each stage.
+    // Nothing is logged if no frame was read since then.
+    void LogSummary();
+
+    // Log totals since start.
+    void LogTotals();
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef _KMICKI_TRACE_TRACE_H_
+#define _KMICKI_TRACE_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace kmicki::trace
+{
+    // Points in the pipeline where frames are stamped with monotonic time.
+    enum Point
+    {
+        PointRead       = 0,    // read from device completed
+        PointProcess    = 1,    // hiddev records processed into frame
+        PointPublish    = 2,    // frame published to consumers
+        PointConsume    = 3,    // frame consumed by cemuhook adapter
+        PointSend       = 4,    // data packet sent to clients
+        PointCount      = 5
+    };
+
+    // Latency histogram with logarithmic buckets, each divided
+    // into 16 linear sub-buckets (max. relative error ~6%).
+    // Recording is lock-free.
+    class Histogram
+    {
+        public:
+        Histogram();
+
+        void Record(uint64_t value);
+        void Reset();
+
+        uint64_t GetCount() const;
+        uint64_t GetMax() const;
+        // Sum of all recorded values.
+        uint64_t GetSum() const;
+        // Get value below which given fraction (0.0-1.0) of recorded values fall.
+        uint64_t GetPercentile(double fraction) const;
+
+        private:
+        static const int cSubBucketBits = 4;
+        static const int cBucketCount = (64 - cSubBucketBits + 1) << cSubBucketBits;
+
+        static int GetIndex(uint64_t value);
+        static uint64_t GetUpperBound(int index);
+
+        std::atomic<uint64_t> counts[cBucketCount];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    extern std::atomic<bool> enabled;
+
+    // Enable tracing. It is disabled by default.
+    void Enable();
+
+    // Is tracing enabled?
+    inline bool IsEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void StampNow(Point point, uint32_t frameId);
+
+    // Stamp frame identified by frameId at given point with current monotonic time.
+    // Latency from the previously stamped point of the same frame is recorded.
+    // Costs one relaxed load when tracing is disabled.
+    inline void Stamp(Point point, uint32_t frameId)
+    {
+        if(IsEnabled())
+            StampNow(point, frameId);
+    }
+
+    // Get histogram of latencies between two points (in ns).
+    Histogram const& GetHistogram(Point from, Point to);
+
+    // Name of a point, e.g. "read".
+    char const* GetPointName(Point point);
+
+    // Log all non-empty histograms.
+    void Dump();
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Sample client of SteamDeckGyroDSU shared memory (server running with SDGYRO_SHM set).
+ * Prints motion data of a slot.
+ *
+ * Usage: shmclient [slot] [count]
+ *     slot: controller slot (default 0)
+ *     count: number of records to print, 0 - until interrupted (default 0)
+ */
+
+#include "sdgyrodsu/sdgyroshm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char ** argv)
+{
+    int slot = argc > 1 ? atoi(argv[1]) : 0;
+    long count = argc > 2 ? atol(argv[2]) : 0;
+    long received = 0;
+    struct sdgyro_shm_reader reader;
+    struct sdgyro_shm_record record;
+    int result;
+
+    result = sdgyro_shm_open(&reader,slot);
+    if(result < 0)
+    {
+        fprintf(stderr,"Failed to open shared memory %s (%s). Is the server running with SDGYRO_SHM set?\n",
+                SDGYRO_SHM_NAME,strerror(-result));
+        return 1;
+    }
+    if(!reader.slot->active)
+        fprintf(stderr,"Slot %d has no controller.\n",slot);
+
+    while(count == 0 || received < count)
+    {
+        result = sdgyro_shm_wait(&reader,&record,1000);
+        if(result == 0)
+        {
+            if(!__atomic_load_n(&reader.slot->active,__ATOMIC_RELAXED))
+            {
+                fprintf(stderr,"Publishing stopped.\n");
+                break;
+            }
+            continue;
+        }
+        ++received;
+        printf("%10u %14llu us  acc % 7.3f % 7.3f % 7.3f  gyro % 9.3f % 9.3f % 9.3f\n",
+               record.increment,(unsigned long long)record.motion.timestamp_us,
+               record.motion.acc_x,record.motion.acc_y,record.motion.acc_z,
+               record.motion.pitch,record.motion.yaw,record.motion.roll);
+    }
+
+    fprintf(stderr,"Received %ld records, missed %u.\n",received,reader.missed);
+    sdgyro_shm_close(&reader);
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include "cemuhook/cemuhookserver.h"
+#include "cemuhook/crc32.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
 
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -8,6 +11,9 @@
 #include <unistd.h>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
 
 using namespace kmicki::sdgyrodsu;
 using namespace kmicki::log;
@@ -15,8 +21,8 @@ using namespace kmicki::log;
 #define PORT 26760
 #define BUFLEN 100
 #define SCANTIME 0
-#define DECKSLOT 0
 #define SENDTIMEOUT_X 3
+#define RECVBATCH 16
 
 #define VERSION_TYPE 0x100000
 #define INFO_TYPE 0x100001
@@ -29,26 +35,62 @@ namespace kmicki::cemuhook
         return inet_ntop(addr.sin_family,&(addr.sin_addr.s_addr),buf,INET6_ADDRSTRLEN);
     }
 
+    // Address of a client in log message. Formatted only if the message is logged.
+    struct AddressText
+    {
+        sockaddr_in const& address;
+    };
+
+    std::ostream & operator<<(std::ostream & stream, AddressText const& text)
+    {
+        char ipStr[INET6_ADDRSTRLEN];
+        ipStr[0] = 0;
+        return stream << "IP: " << GetIP(text.address,ipStr) << " Port: " << ntohs(text.address.sin_port);
+    }
+
     uint32_t crc32(const unsigned char *s,size_t n) {
-        uint32_t crc=0xFFFFFFFF;
-        
-        int k;
+        return Crc32(s,n);
+    }
 
-        while (n--) {
-            crc ^= *s++;
-            for (k = 0; k < 8; k++)
-                crc = crc & 1 ? (crc >> 1) ^ 0xedb88320  : crc >> 1;
-        }
-        return ~crc;
+    // Data packet differs between clients only by id - its CRC is patched instead of recalculated.
+    static const Crc32Patch dataAnswerIdPatch(sizeof(DataEvent),offsetof(DataEvent,header)+offsetof(Header,id));
+
+    Server::Server(CemuhookAdapter & _motionSource, pipeline::RealtimeProfile const& _receiveProfile, pipeline::RealtimeProfile const& _sendProfile)
+        : Server(std::vector<CemuhookAdapter*>{&_motionSource},_receiveProfile,_sendProfile)
+    { }
+
+    Server::Server(std::vector<CemuhookAdapter*> const& _motionSources, pipeline::RealtimeProfile const& _receiveProfile, pipeline::RealtimeProfile const& _sendProfile)
+        : stop(false), serverThread(), mainMutex(), checkTimeout(false),
+          receiveProfile(_receiveProfile), sendProfile(_sendProfile),
+          externalLoop(false)
+    {
+        AssignSlots(_motionSources);
+        PrepareAnswerConstants();
+        Start();
     }
 
-    Server::Server(CemuhookAdapter & _motionSource)
-        : motionSource(_motionSource), stop(false), serverThread(), stopSending(false),
-          mainMutex(), stopSendMutex(), socketSendMutex(), checkTimeout(false)
+    Server::Server(CemuhookAdapter & _motionSource, bool const& _externalLoop)
+        : stop(false), serverThread(), mainMutex(), checkTimeout(false),
+          receiveProfile(), sendProfile(),
+          externalLoop(_externalLoop)
     {
+        AssignSlots({&_motionSource});
         PrepareAnswerConstants();
         Start();
     }
+
+    void Server::AssignSlots(std::vector<CemuhookAdapter*> const& motionSources)
+    {
+        availableSlots = 0;
+        for(int i = 0; i < cSlotCount; ++i)
+        {
+            slots[i].motionSource = (i < motionSources.size()) ? motionSources[i] : nullptr;
+            slots[i].packet = 0;
+            slots[i].stopSending = false;
+            if(slots[i].motionSource != nullptr)
+                availableSlots |= 1 << i;
+        }
+    }
     
     Server::~Server()
     {
@@ -107,7 +149,8 @@ namespace kmicki::cemuhook
         { LogF() << "Server: Socket created at IP: " << GetIP(sockInServer,ipStr) << " Port: " << ntohs(sockInServer.sin_port) << "."; }
 
         stop = false;
-        serverThread.reset(new std::thread(&Server::serverTask,this));
+        if(!externalLoop)
+            serverThread.reset(new std::thread(&Server::serverTask,this));
         Log("Server: Initialized.",LogLevelDebug);
     }
 
@@ -123,6 +166,7 @@ namespace kmicki::cemuhook
 
         versionAnswer.header = outHeader;
         versionAnswer.header.length = sizeof(versionAnswer.version) + 4;
+        versionAnswer.header.eventType = VERSION_TYPE;
         versionAnswer.version = 1001;
 
         SharedResponse sresponse;
@@ -137,20 +181,21 @@ namespace kmicki::cemuhook
         infoDeckAnswer.header.eventType = INFO_TYPE;
         infoDeckAnswer.header.length = sizeof(infoDeckAnswer.response) + 4;
         infoDeckAnswer.response = sresponse;
-        infoDeckAnswer.response.slot = DECKSLOT;
+        infoDeckAnswer.response.slot = 0;
 
         infoNoneAnswer = infoDeckAnswer;
         infoNoneAnswer.response.deviceModel = 0;
         infoNoneAnswer.response.connection = 0;
         infoNoneAnswer.response.slotState = 0;
 
+        DataEvent dataAnswer;
         dataAnswer.header = outHeader;
         dataAnswer.header.eventType = DATA_TYPE;
         dataAnswer.header.length = sizeof(dataAnswer) - 16;
         dataAnswer.response = sresponse;
         dataAnswer.response.slotState = 2;
         dataAnswer.response.connected = 1;
-        dataAnswer.response.slot = DECKSLOT;
+        dataAnswer.response.slot = 0;
         
         char* dataAnswerPointer = reinterpret_cast<char*>(&dataAnswer.buttons1);
         auto len = sizeof(DataEvent) - sizeof(Header) - sizeof(SharedResponse) - sizeof(MotionData);
@@ -159,6 +204,12 @@ namespace kmicki::cemuhook
             // clear most data
             dataAnswerPointer[i] = 0;
         }
+
+        for(int i = 0; i < cSlotCount; ++i)
+        {
+            slots[i].dataAnswer = dataAnswer;
+            slots[i].dataAnswer.response.slot = i;
+        }
     }
 
     ssize_t SendPacket(int const& socketFd, std::pair<uint16_t , void const*> const& outBuf, sockaddr_in const& sockInClient)
@@ -166,65 +217,240 @@ namespace kmicki::cemuhook
         return sendto(socketFd,outBuf.second,outBuf.first,0,(sockaddr*) &sockInClient, sizeof(sockInClient));
     }
 
-    void Server::CheckClientTimeout(std::unique_ptr<std::thread> & sendThread, bool increment)
+    // Send prepared messages with as few calls as possible.
+    void SendPackets(int const& socketFd, mmsghdr * messages, unsigned int const& count)
+    {
+        unsigned int sent = 0;
+        while(sent < count)
+        {
+            auto result = sendmmsg(socketFd,messages+sent,count-sent,0);
+            if(result < 0 && errno == EINTR)
+                continue;
+            // sendmmsg fails only if the first message fails - skip it like a failed sendto
+            if(result > 0)
+            {
+                stats::Add(stats::CounterServerPackets,result);
+                sent += result;
+            }
+            else
+            {
+                stats::Add(stats::CounterServerSendFailed);
+                ++sent;
+            }
+        }
+    }
+
+    // Buffers for receiving a batch of requests in one call.
+    struct RequestBatch
+    {
+        char buffers[RECVBATCH][BUFLEN];
+        sockaddr_in addresses[RECVBATCH];
+        iovec vecs[RECVBATCH];
+        mmsghdr messages[RECVBATCH];
+
+        RequestBatch()
+        {
+            for(int i = 0; i < RECVBATCH; ++i)
+            {
+                vecs[i].iov_base = buffers[i];
+                vecs[i].iov_len = BUFLEN;
+                messages[i] = mmsghdr();
+                messages[i].msg_hdr.msg_name = &addresses[i];
+                messages[i].msg_hdr.msg_iov = &vecs[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+        }
+
+        // Receive pending requests. Returns number of received requests or -1.
+        int Receive(int const& socketFd, int const& flags)
+        {
+            for(int i = 0; i < RECVBATCH; ++i)
+                messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+            return recvmmsg(socketFd,messages,RECVBATCH,flags,nullptr);
+        }
+    };
+
+    bool Server::RemoveTimedOutClients(bool increment)
     {
         static const int cSendTimeout = 3;
 
         char ipStr[INET6_ADDRSTRLEN];
         ipStr[0] = 0;
 
+        std::lock_guard lock(clientsMutex);
+        checkTimeout = false;
+        auto client = clients.begin();
+        while(client != clients.end())
         {
-            std::lock_guard lock(clientsMutex);
-            checkTimeout = false;
-            auto client = clients.begin();
-            while(client != clients.end())
+            if(increment)
+                ++client->sendTimeout;
+            if(client->sendTimeout > cSendTimeout)
+            {       
+                { LogF() << "Server: No packet from client for some time. IP: " << GetIP(client->address,ipStr) << " Port: " << ntohs(client->address.sin_port); }
+
+                client = clients.erase(client);
+                stats::Add(stats::CounterServerClientsTimedOut);
+            }
+            else
             {
-                if(increment)
-                    ++client->sendTimeout;
-                if(client->sendTimeout > cSendTimeout)
-                {       
-                    { LogF() << "Server: No packet from client for some time. IP: " << GetIP(client->address,ipStr) << " Port: " << ntohs(client->address.sin_port); }
+                ++client;
+            }
+        }
+        return clients.empty();
+    }
 
-                    client = clients.erase(client);
-                }
-                else
-                {
-                    ++client;
-                }
+    void Server::ReserveBatches()
+    {
+        for(auto & slot : slots)
+        {
+            if(slot.batchMessages.size() < clients.size())
+            {
+                slot.batchVecs.resize(clients.size()*2);
+                slot.batchMessages.resize(clients.size());
             }
         }
+    }
+
+    uint8_t Server::GetSubscribedSlots()
+    {
+        uint8_t subscribed = 0;
+        std::shared_lock lock(clientsMutex);
+        for(auto const& client : clients)
+            subscribed |= client.slots;
+        return subscribed;
+    }
+
+    void Server::StartSending()
+    {
+        auto subscribed = GetSubscribedSlots();
+        for(int i = 0; i < cSlotCount; ++i)
         {
-            std::shared_lock clientsLock(clientsMutex);
-            if(sendThread.get() != nullptr && clients.empty())
+            auto & slot = slots[i];
+            if((subscribed & (1 << i)) && slot.sendThread.get() == nullptr)
             {
-                clientsLock.unlock();
-                Log("Server: No more clients. Stop sending data.");
-                {
-                    std::lock_guard lock(stopSendMutex);
-                    stopSending = true;
-                }
-                sendThread.get()->join();
-                sendThread.reset();
+                slot.stopSending = false;
+                slot.sendThread.reset(new std::thread(&Server::sendTask,this,i));
             }
         }
+    }
 
+    void Server::StopSending(Slot & slot)
+    {
+        if(slot.sendThread.get() == nullptr)
+            return;
+        {
+            std::lock_guard lock(slot.stopSendMutex);
+            slot.stopSending = true;
+        }
+        slot.sendThread.get()->join();
+        slot.sendThread.reset();
     }
 
-    void Server::serverTask()
+    void Server::CheckClientTimeout(bool increment)
     {
+        RemoveTimedOutClients(increment);
 
-        char buf[BUFLEN];
-        sockaddr_in sockInClient;
-        socklen_t sockInLen = sizeof(sockInClient);
+        // only receiving thread adds clients, so the list can't get refilled in the meantime
+        auto subscribed = GetSubscribedSlots();
+        for(int i = 0; i < cSlotCount; ++i)
+        {
+            auto & slot = slots[i];
+            if(!(subscribed & (1 << i)) && slot.sendThread.get() != nullptr)
+            {
+                { LogF() << "Server: No more clients of slot " << i << ". Stop sending data."; }
+                StopSending(slot);
+            }
+        }
+    }
 
+    bool Server::HandleRequest(char * buf, ssize_t const& len, sockaddr_in const& sockInClient)
+    {
         auto headerSize = (ssize_t)sizeof(Header);
 
         std::pair<uint16_t , void const*> outBuf;
+        bool subscribed = false;
 
-        std::unique_ptr<std::thread> sendThread;
+        Header & header = *reinterpret_cast<Header*>(buf);
 
-        char ipStr[INET6_ADDRSTRLEN];
-        ipStr[0] = 0;
+        AddressText addressText { sockInClient };
+
+        switch(header.eventType)
+        {
+            case VERSION_TYPE:
+                { LogF(LogLevelTrace) << "Server: A client asked for version. " << addressText << "."; }
+                outBuf = PrepareVersionAnswer(header.id);
+                SendPacket(socketFd,outBuf,sockInClient);
+                break;
+            case INFO_TYPE:
+                { LogF(LogLevelTrace) << "Server: A client asked for controller info. " << addressText << "."; }
+                {
+                    InfoRequest & req = *reinterpret_cast<InfoRequest*>(buf+headerSize);
+                    for (int i = 0; i < req.portCnt; i++)
+                    {
+                        outBuf = PrepareInfoAnswer(header.id, req.slots[i]);
+                        SendPacket(socketFd,outBuf,sockInClient);
+                    }
+                }
+                break;
+            case DATA_TYPE:
+                {
+                    // Subscription to one slot or all of them (MAC-based subscription: all slots share MAC)
+                    uint8_t requestedSlots = availableSlots;
+                    if(len >= headerSize + 2)   // mask and slot (MAC is not used)
+                    {
+                        SubscribeRequest & req = *reinterpret_cast<SubscribeRequest*>(buf+headerSize);
+                        if(req.mask & 1)
+                            requestedSlots &= (req.slot < cSlotCount) ? (1 << req.slot) : 0;
+                    }
+                    if(requestedSlots == 0)
+                        break;
+
+                    std::shared_lock sharedLock(clientsMutex);
+                    auto client = std::find(clients.begin(),clients.end(),sockInClient);
+                    if(client == clients.end())
+                    {
+                        { LogF(LogLevelTrace) << "Server: Request for data from new client. " << addressText << "."; }
+                        sharedLock.unlock();
+                        {
+                            std::lock_guard lock(clientsMutex);
+                            auto& newClient = clients.emplace_back();
+                            newClient.address = sockInClient;
+                            newClient.id = header.id;
+                            newClient.sendTimeout = 0;
+                            newClient.slots = requestedSlots;
+                            newClient.packets.fill(0);
+                            ReserveBatches();
+                        }
+                        stats::Add(stats::CounterServerClientsAdded);
+                        { LogF() << "Server: New client subscribed. " << addressText << "."; }
+
+                        subscribed = true;
+                    }
+                    else
+                    {
+                        // { LogF(LogLevelTrace) << "Server: Request for data from existing client. " << addressText << "."; }
+                        subscribed = (client->slots & requestedSlots) != requestedSlots;
+                        sharedLock.unlock();
+                        {
+                            std::lock_guard lock(clientsMutex);
+                            client->sendTimeout = 0;
+                            client->slots |= requestedSlots;
+                        }
+                    }
+                }
+                break;
+        }
+
+        return subscribed;
+    }
+
+    void Server::serverTask()
+    {
+        pipeline::ApplyRealtimeProfile("sdgyro-server",receiveProfile);
+
+        RequestBatch batch;
+
+        auto headerSize = (ssize_t)sizeof(Header);
 
         Log("Server: Start listening for client.");
         
@@ -232,138 +458,72 @@ namespace kmicki::cemuhook
         while(!stop)
         {
             mainLock.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
-            auto recvLen = recvfrom(socketFd,buf,BUFLEN,0,(sockaddr*) &sockInClient, &sockInLen);
-            if(recvLen >= headerSize)
-            {                
-                Header & header = *reinterpret_cast<Header*>(buf);
-
-                std::ostringstream addressTextStream;
-                addressTextStream << "IP: " << GetIP(sockInClient,ipStr) << " Port: " << ntohs(sockInClient.sin_port);
-                auto addressText = addressTextStream.str();
-
-                switch(header.eventType)
+            // Wait for a request (up to socket's receive timeout) and take all other pending ones with it.
+            auto count = batch.Receive(socketFd,MSG_WAITFORONE);
+            if(count > 0)
+            {
+                bool subscribed = false;
+                for(int i = 0; i < count; ++i)
                 {
-                    case VERSION_TYPE:
-                        { LogF(LogLevelTrace) << "Server: A client asked for version. " << addressText << "."; }
-                        outBuf = PrepareVersionAnswer(header.id);
-                        {
-                            std::lock_guard lock(socketSendMutex);
-                            SendPacket(socketFd,outBuf,sockInClient);
-                        }
-                        break;
-                    case INFO_TYPE:
-                        { LogF(LogLevelTrace) << "Server: A client asked for controller info. " << addressText << "."; }
-                        {
-                            InfoRequest & req = *reinterpret_cast<InfoRequest*>(buf+headerSize);
-                            for (int i = 0; i < req.portCnt; i++)
-                            {
-                                outBuf = PrepareInfoAnswer(header.id, req.slots[i]);
-                                {
-                                    std::lock_guard lock(socketSendMutex);
-                                    SendPacket(socketFd,outBuf,sockInClient);
-                                }
-                            }
-                        }
-                        break;
-                    case DATA_TYPE:
-                        {                           
-                            std::shared_lock sharedLock(clientsMutex);
-                            auto client = std::find(clients.begin(),clients.end(),sockInClient);
-                            if(client == clients.end())
-                            {
-                                { LogF(LogLevelTrace) << "Server: Request for data from new client. " << addressText << "."; }
-                                sharedLock.unlock();
-                                {
-                                    std::lock_guard lock(clientsMutex);
-                                    auto& newClient = clients.emplace_back();
-                                    newClient.address = sockInClient;
-                                    newClient.id = header.id;
-                                    newClient.sendTimeout = 0;
-                                }
-                                { LogF() << "Server: New client subscribed. " << addressText << "."; }
-
-                                if(sendThread.get() == nullptr)
-                                {
-                                    stopSending = false;
-                                    sendThread.reset(new std::thread(&Server::sendTask,this));
-                                }
-                            }
-                            else
-                            {
-                                // { LogF(LogLevelTrace) << "Server: Request for data from existing client. " << addressText << "."; }
-                                sharedLock.unlock();
-                                {
-                                    std::lock_guard lock(clientsMutex);
-                                    client->sendTimeout = 0;
-                                }
-                            }
-                        }
-                        break;
+                    ssize_t recvLen = batch.messages[i].msg_len;
+                    if(recvLen >= headerSize)
+                        subscribed = HandleRequest(batch.buffers[i],recvLen,batch.addresses[i]) || subscribed;
                 }
+                if(subscribed)
+                    StartSending();
                 {
                     std::shared_lock lock(clientsMutex);
                     if(checkTimeout)
                     {
                         lock.unlock();
-                        CheckClientTimeout(sendThread,false);
+                        CheckClientTimeout(false);
                     }
                 }
             }
             else 
             {
-                CheckClientTimeout(sendThread,true);
+                CheckClientTimeout(true);
             }
             mainLock.lock();
         }
 
-        if(sendThread.get() != nullptr)
-        {
-            Log("Server: Stopping send thread...",LogLevelDebug);
-            {
-                std::lock_guard lock(stopSendMutex);
-                stopSending = true;
-            }
-            sendThread.get()->join();
-        }
+        Log("Server: Stopping send threads...",LogLevelDebug);
+        for(auto & slot : slots)
+            StopSending(slot);
         Log("Server: Stopped.");
     }
 
-    void Server::sendTask()
+    void Server::sendTask(int slotNo)
     {
         static const uint32_t cTimeoutIncreasePeriod = 500;
 
+        auto & slot = slots[slotNo];
+        uint8_t lowerSlots = (1 << slotNo) - 1;
+
+        pipeline::ApplyRealtimeProfile("sdgyro-send"+std::to_string(slotNo),sendProfile);
+
         Log("Server: Initiating frame grab start.",LogLevelDebug);
-        motionSource.StartFrameGrab();
+        slot.motionSource->StartFrameGrab();
 
-        std::pair<uint16_t , void const*> outBuf;
-        uint32_t packet = 0;
+        slot.packet = 0;
 
-        Log("Server: Start sending controller data.",LogLevelDebug);
+        { LogF(LogLevelDebug) << "Server: Start sending controller data of slot " << slotNo << "."; }
 
-        std::unique_lock mainLock(stopSendMutex);
+        std::unique_lock mainLock(slot.stopSendMutex);
 
-        while(!stopSending)
+        while(!slot.stopSending)
         {
             mainLock.unlock();
-            outBuf = PrepareDataAnswerWithoutCrc(0,++packet);
-            {
-                std::shared_lock lock(clientsMutex);
-                for(auto& client : clients)
-                {
-                    ModifyDataAnswerId(client.id);
-                    {
-                        std::lock_guard lock(socketSendMutex);
-                        SendPacket(socketFd,outBuf,client.address);
-                    }
-                }
-            }
-            if(packet % cTimeoutIncreasePeriod == 0)
+            PrepareDataAnswerWithoutCrc(slot,0,++slot.packet);
+            SendDataAnswer(slotNo);
+            if(slot.packet % cTimeoutIncreasePeriod == 0)
             {
                 std::lock_guard lock(clientsMutex);
                 for(auto& client : clients)
                 {
-                    ++client.sendTimeout;
+                    // period of client is counted by thread of its first subscribed slot
+                    if((client.slots & (1 << slotNo)) && !(client.slots & lowerSlots))
+                        ++client.sendTimeout;
                 }
                 checkTimeout = true;
             }
@@ -373,10 +533,134 @@ namespace kmicki::cemuhook
 
         Log("Server: Initiating frame grab stop.",LogLevelDebug);
 
-        motionSource.StopFrameGrab();
-        Log("Server: Stop sending controller data.",LogLevelDebug);
+        slot.motionSource->StopFrameGrab();
+        { LogF(LogLevelDebug) << "Server: Stop sending controller data of slot " << slotNo << "."; }
+    }
+
+
+    void Server::SendDataAnswer(int const& slotNo)
+    {
+        static const size_t payloadLen = sizeof(DataEvent) - sizeof(Header);
+        static_assert(offsetof(DataEvent,response) == sizeof(Header),"Payload of data packet has to follow the header.");
+
+        auto & slot = slots[slotNo];
+        uint8_t slotBit = 1 << slotNo;
+
+        // CRC of the frame is calculated once, then patched for id of each client
+        CalcCrcDataAnswer(slot.dataAnswer);
+        void * payload = &slot.dataAnswer.response;
+
+        std::shared_lock lock(clientsMutex);
+        unsigned int count = 0;
+        for(auto& client : clients)
+        {
+            if(!(client.slots & slotBit))
+                continue;
+            auto & header = client.dataHeaders[slotNo];
+            PrepareDataHeader(header,slot.dataAnswer,client.id);
+
+            std::atomic_ref<uint64_t> packets(client.packets[slotNo]);
+            packets.store(packets.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+
+            auto vecs = &slot.batchVecs[count*2];
+            vecs[0].iov_base = &header;
+            vecs[0].iov_len = sizeof(header);
+            vecs[1].iov_base = payload;
+            vecs[1].iov_len = payloadLen;
+
+            if(sender)
+            {
+                sender(vecs,2,client.address);
+                continue;
+            }
+
+            auto & message = slot.batchMessages[count];
+            message = mmsghdr();
+            message.msg_hdr.msg_name = &client.address;
+            message.msg_hdr.msg_namelen = sizeof(client.address);
+            message.msg_hdr.msg_iov = vecs;
+            message.msg_hdr.msg_iovlen = 2;
+            ++count;
+        }
+        // all clients are sent in one call
+        SendPackets(socketFd,slot.batchMessages.data(),count);
+        lock.unlock();
+        trace::Stamp(trace::PointSend,slot.motionSource->GetLastIncrement());
+    }
+
+    std::vector<Server::ClientInfo> Server::GetClients()
+    {
+        std::vector<ClientInfo> info;
+        std::shared_lock lock(clientsMutex);
+        for(auto & client : clients)
+        {
+            auto & clientInfo = info.emplace_back();
+            clientInfo.address = client.address;
+            clientInfo.slots = client.slots;
+            clientInfo.packets = 0;
+            for(auto & packets : client.packets)
+                clientInfo.packets += std::atomic_ref<uint64_t>(packets).load(std::memory_order_relaxed);
+        }
+        return info;
+    }
+
+    int Server::GetSocketFd()
+    {
+        return socketFd;
+    }
+
+    bool Server::ReceiveRequests()
+    {
+        RequestBatch batch;
+
+        auto headerSize = (ssize_t)sizeof(Header);
+
+        while(true)
+        {
+            auto count = batch.Receive(socketFd,MSG_DONTWAIT);
+            if(count <= 0)
+                break;
+            for(int i = 0; i < count; ++i)
+            {
+                ssize_t recvLen = batch.messages[i].msg_len;
+                if(recvLen >= headerSize)
+                    HandleRequest(batch.buffers[i],recvLen,batch.addresses[i]);
+            }
+            if(count < RECVBATCH)
+                break;
+        }
+
+        return HasClients();
+    }
+
+    void Server::SendData(MotionData const& motion)
+    {
+        auto & slot = slots[0];
+        slot.dataAnswer.header.id = 0;
+        slot.dataAnswer.packetNumber = ++slot.packet;
+        slot.dataAnswer.motion = motion;
+        SendDataAnswer(0);
+    }
+
+    void Server::SetSender(sender_t const& _sender)
+    {
+        sender = _sender;
     }
 
+    bool Server::HasClients()
+    {
+        std::shared_lock lock(clientsMutex);
+        return !clients.empty();
+    }
+
+    void Server::TickClientTimeout()
+    {
+        if(RemoveTimedOutClients(true) && slots[0].packet > 0)
+        {
+            Log("Server: No more clients. Stop sending data.");
+            slots[0].packet = 0;
+        }
+    }
 
     std::pair<uint16_t , void const*> Server::PrepareVersionAnswer(uint32_t const& id)
     {
@@ -392,7 +676,7 @@ namespace kmicki::cemuhook
     {
         static const uint16_t len = sizeof(infoNoneAnswer);
 
-        if(slot != DECKSLOT)
+        if(slot >= cSlotCount || slots[slot].motionSource == nullptr)
         {
             infoNoneAnswer.header.id = id;
             infoNoneAnswer.response.slot = slot;
@@ -403,33 +687,33 @@ namespace kmicki::cemuhook
         
         infoDeckAnswer.header.id = id;
         infoDeckAnswer.response.slot = slot;
-        infoDeckAnswer.response.slotState = motionSource.IsControllerConnected()?2:0;
+        infoDeckAnswer.response.slotState = slots[slot].motionSource->IsControllerConnected()?2:0;
         infoDeckAnswer.header.crc32 = 0;
         infoDeckAnswer.header.crc32 = crc32(reinterpret_cast<unsigned char *>(&infoDeckAnswer),len);
         return std::pair<uint16_t , void const*>(len, reinterpret_cast<void *>(&infoDeckAnswer));
     }
 
-    std::pair<uint16_t , void const*> Server::PrepareDataAnswer(uint32_t const& id, uint32_t const& packet) 
+    std::pair<uint16_t , void const*> Server::PrepareDataAnswer(Slot & slot, uint32_t const& id, uint32_t const& packet) 
     {
-        static const uint16_t len = sizeof(dataAnswer);
+        static const uint16_t len = sizeof(DataEvent);
 
-        PrepareDataAnswerWithoutCrc(id,packet);
-        CalcCrcDataAnswer();
-        return std::pair<uint16_t , void const*>(len, reinterpret_cast<void *>(&dataAnswer));
+        PrepareDataAnswerWithoutCrc(slot,id,packet);
+        CalcCrcDataAnswer(slot.dataAnswer);
+        return std::pair<uint16_t , void const*>(len, reinterpret_cast<void *>(&slot.dataAnswer));
     }
 
-    std::pair<uint16_t , void const*> Server::PrepareDataAnswerWithoutCrc(uint32_t const& id, uint32_t const& packet) 
+    std::pair<uint16_t , void const*> Server::PrepareDataAnswerWithoutCrc(Slot & slot, uint32_t const& id, uint32_t const& packet) 
     {
-        static const uint16_t len = sizeof(dataAnswer);
+        static const uint16_t len = sizeof(DataEvent);
         
-        dataAnswer.header.id = id;
-        dataAnswer.packetNumber = packet;
-        motionSource.SetMotionDataNewFrame(dataAnswer.motion);
+        slot.dataAnswer.header.id = id;
+        slot.dataAnswer.packetNumber = packet;
+        slot.motionSource->SetMotionDataNewFrame(slot.dataAnswer.motion);
         
-        return std::pair<uint16_t , void const*>(len, reinterpret_cast<void *>(&dataAnswer));
+        return std::pair<uint16_t , void const*>(len, reinterpret_cast<void *>(&slot.dataAnswer));
     }
 
-    void Server::CalcCrcDataAnswer()
+    void Server::CalcCrcDataAnswer(DataEvent & dataAnswer)
     {
         static const uint16_t len = sizeof(dataAnswer);
 
@@ -437,10 +721,11 @@ namespace kmicki::cemuhook
         dataAnswer.header.crc32 = crc32(reinterpret_cast<unsigned char *>(&dataAnswer),len);
     }
 
-    void Server::ModifyDataAnswerId(uint32_t const& id) 
+    void Server::PrepareDataHeader(Header & header, DataEvent const& dataAnswer, uint32_t const& id) 
     {
-        dataAnswer.header.id = id;
-        CalcCrcDataAnswer();
+        header = dataAnswer.header;
+        header.crc32 = dataAnswerIdPatch(dataAnswer.header.crc32,dataAnswer.header.id,id);
+        header.id = id;
     }
 
     bool Server::Client::operator==(sockaddr_in const& other)
@@ -0,0 +1,261 @@
+#include "cemuhook/crc32.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace kmicki::cemuhook
+{
+    static const uint32_t cCrc32Poly = 0xedb88320;    // reflected polynomial
+
+    // table[0] - CRC of single byte,
+    // table[k] - CRC of byte followed by k zero bytes (for slice-by-8)
+    struct Crc32Tables
+    {
+        uint32_t table[8][256];
+    };
+
+    static constexpr Crc32Tables MakeCrc32Tables()
+    {
+        Crc32Tables tables = {};
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for(int k = 0; k < 8; ++k)
+                crc = crc & 1 ? (crc >> 1) ^ cCrc32Poly : crc >> 1;
+            tables.table[0][i] = crc;
+        }
+        for(uint32_t i = 0; i < 256; ++i)
+            for(int t = 1; t < 8; ++t)
+                tables.table[t][i] = (tables.table[t-1][i] >> 8) ^ tables.table[0][tables.table[t-1][i] & 0xFF];
+        return tables;
+    }
+
+    static constexpr Crc32Tables cCrc32Tables = MakeCrc32Tables();
+
+    namespace kernel
+    {
+        uint32_t Crc32Bitwise(void const* data, size_t len, uint32_t crc)
+        {
+            auto s = reinterpret_cast<unsigned char const*>(data);
+            crc = ~crc;
+            while (len--) {
+                crc ^= *s++;
+                for (int k = 0; k < 8; k++)
+                    crc = crc & 1 ? (crc >> 1) ^ cCrc32Poly : crc >> 1;
+            }
+            return ~crc;
+        }
+
+        uint32_t Crc32Slice8(void const* data, size_t len, uint32_t crc)
+        {
+            auto const& t = cCrc32Tables.table;
+            auto s = reinterpret_cast<unsigned char const*>(data);
+            crc = ~crc;
+            for(; len >= 8; len -= 8, s += 8)
+            {
+                uint32_t lo = crc ^ (s[0] | s[1] << 8 | s[2] << 16 | (uint32_t)s[3] << 24);
+                crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+                    ^ t[3][s[4]] ^ t[2][s[5]] ^ t[1][s[6]] ^ t[0][s[7]];
+            }
+            while(len--)
+                crc = t[0][(crc ^ *s++) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        // Fold 128 bits of x over 128 bits onto next.
+        __attribute__((target("pclmul")))
+        static inline __m128i Fold128(__m128i x, __m128i next, __m128i k)
+        {
+            auto lo = _mm_clmulepi64_si128(x,k,0x00);
+            auto hi = _mm_clmulepi64_si128(x,k,0x11);
+            return _mm_xor_si128(_mm_xor_si128(hi,next),lo);
+        }
+
+        // Fold 4 x 128 bits per 64-byte block, fold to 128 bits, then to 64 bits
+        // and Barrett-reduce to 32 bits (Intel: "Fast CRC Computation Using PCLMULQDQ Instruction").
+        // Constants are x^n mod P (bit-reflected) for the fold distances and Barrett reduction.
+        // Works on multiples of 16 bytes, at least 64 of them. The rest goes through slice-by-8.
+        __attribute__((target("pclmul,sse4.1")))
+        uint32_t Crc32Pclmul(void const* data, size_t len, uint32_t crc)
+        {
+            if(len < 64)
+                return Crc32Slice8(data,len,crc);
+
+            alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+            alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+            alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+            alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+            auto buf = reinterpret_cast<char const*>(data);
+            auto rest = len & 15;
+            len -= rest;
+
+            auto x1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x00));
+            auto x2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x10));
+            auto x3 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x20));
+            auto x4 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x30));
+            x1 = _mm_xor_si128(x1,_mm_cvtsi32_si128(~crc));
+
+            auto x0 = _mm_load_si128(reinterpret_cast<__m128i const*>(k1k2));
+            buf += 64;
+            len -= 64;
+
+            // fold blocks of 64 bytes in parallel
+            while(len >= 64)
+            {
+                auto x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+                auto x6 = _mm_clmulepi64_si128(x2,x0,0x00);
+                auto x7 = _mm_clmulepi64_si128(x3,x0,0x00);
+                auto x8 = _mm_clmulepi64_si128(x4,x0,0x00);
+
+                x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+                x2 = _mm_clmulepi64_si128(x2,x0,0x11);
+                x3 = _mm_clmulepi64_si128(x3,x0,0x11);
+                x4 = _mm_clmulepi64_si128(x4,x0,0x11);
+
+                x1 = _mm_xor_si128(_mm_xor_si128(x1,x5),_mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x00)));
+                x2 = _mm_xor_si128(_mm_xor_si128(x2,x6),_mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x10)));
+                x3 = _mm_xor_si128(_mm_xor_si128(x3,x7),_mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x20)));
+                x4 = _mm_xor_si128(_mm_xor_si128(x4,x8),_mm_loadu_si128(reinterpret_cast<__m128i const*>(buf+0x30)));
+
+                buf += 64;
+                len -= 64;
+            }
+
+            // fold into 128 bits
+            x0 = _mm_load_si128(reinterpret_cast<__m128i const*>(k3k4));
+
+            x1 = Fold128(x1,x2,x0);
+            x1 = Fold128(x1,x3,x0);
+            x1 = Fold128(x1,x4,x0);
+
+            // fold remaining blocks of 16 bytes
+            for(; len >= 16; buf += 16, len -= 16)
+                x1 = Fold128(x1,_mm_loadu_si128(reinterpret_cast<__m128i const*>(buf)),x0);
+
+            // fold 128 bits to 64 bits
+            x2 = _mm_clmulepi64_si128(x1,x0,0x10);
+            x3 = _mm_setr_epi32(~0,0,~0,0);
+            x1 = _mm_xor_si128(_mm_srli_si128(x1,8),x2);
+
+            x0 = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(k5k0));
+            x2 = _mm_srli_si128(x1,4);
+            x1 = _mm_and_si128(x1,x3);
+            x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1,x0,0x00),x2);
+
+            // Barrett reduction to 32 bits
+            x0 = _mm_load_si128(reinterpret_cast<__m128i const*>(poly));
+            x2 = _mm_and_si128(x1,x3);
+            x2 = _mm_clmulepi64_si128(x2,x0,0x10);
+            x2 = _mm_and_si128(x2,x3);
+            x2 = _mm_clmulepi64_si128(x2,x0,0x00);
+            x1 = _mm_xor_si128(x1,x2);
+
+            crc = ~(uint32_t)_mm_extract_epi32(x1,1);
+            return Crc32Slice8(buf,rest,crc);
+        }
+
+        bool IsPclmulSupported()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+        }
+#endif
+
+#if defined(__aarch64__)
+        __attribute__((target("+crc")))
+        uint32_t Crc32Armv8(void const* data, size_t len, uint32_t crc)
+        {
+            auto s = reinterpret_cast<unsigned char const*>(data);
+            crc = ~crc;
+            for(; len >= 8; len -= 8, s += 8)
+            {
+                uint64_t word;
+                memcpy(&word,s,sizeof(word));
+                crc = __crc32d(crc,word);
+            }
+            while(len--)
+                crc = __crc32b(crc,*s++);
+            return ~crc;
+        }
+
+        bool IsArmv8CrcSupported()
+        {
+            return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+        }
+#endif
+    }
+
+    typedef uint32_t (*Crc32Fn)(void const*, size_t, uint32_t);
+
+    struct Crc32Kernel
+    {
+        Crc32Fn crc32;
+        char const* name;
+    };
+
+    static Crc32Kernel SelectCrc32Kernel()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if(kernel::IsPclmulSupported())
+            return { kernel::Crc32Pclmul, "pclmul" };
+#endif
+#if defined(__aarch64__)
+        if(kernel::IsArmv8CrcSupported())
+            return { kernel::Crc32Armv8, "armv8" };
+#endif
+        return { kernel::Crc32Slice8, "slice8" };
+    }
+
+    static Crc32Kernel const& GetCrc32Kernel()
+    {
+        static const Crc32Kernel crc32Kernel = SelectCrc32Kernel();
+        return crc32Kernel;
+    }
+
+    uint32_t Crc32(void const* data, size_t len, uint32_t crc)
+    {
+        return GetCrc32Kernel().crc32(data,len,crc);
+    }
+
+    char const* GetCrc32KernelName()
+    {
+        return GetCrc32Kernel().name;
+    }
+
+    Crc32Patch::Crc32Patch(size_t const& messageLen, size_t const& fieldOffset)
+    {
+        auto const& t = cCrc32Tables.table[0];
+        for(int k = 0; k < 4; ++k)
+        {
+            // change of CRC caused by byte k of the field = CRC (without pre/post inversion)
+            // of that byte followed by zero bytes until the end of the message
+            auto zeros = messageLen - fieldOffset - k - 1;
+            for(uint32_t b = 0; b < 256; ++b)
+            {
+                uint32_t crc = t[b];
+                for(size_t i = 0; i < zeros; ++i)
+                    crc = t[crc & 0xFF] ^ (crc >> 8);
+                table[k][b] = crc;
+            }
+        }
+    }
+
+    uint32_t Crc32Patch::operator()(uint32_t const& crc, uint32_t const& oldField, uint32_t const& newField) const
+    {
+        uint32_t diff = oldField ^ newField;
+        unsigned char bytes[4];
+        memcpy(bytes,&diff,sizeof(bytes));  // bytes in order of the message
+        return crc ^ table[0][bytes[0]] ^ table[1][bytes[1]] ^ table[2][bytes[2]] ^ table[3][bytes[3]];
+    }
+}
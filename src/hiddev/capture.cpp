@@ -0,0 +1,233 @@
+#include "hiddev/capture.h"
+#include "log/log.h"
+
+#include <cstring>
+#include <algorithm>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+using namespace kmicki::log;
+
+namespace kmicki::hiddev
+{
+    static const char cCaptureMagic[8] = { 'S','D','G','Y','R','O','C','P' };
+    static const uint32_t cCaptureVersion = 1;
+    static const size_t cCaptureBufferLen = 64*1024;
+    static const size_t cCapturePreallocatedBlocks = 4;
+    static const size_t cCaptureMaxQueuedBlocks = 64;  // more unwritten blocks - records are dropped
+
+    uint64_t GetMonotonicNs()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        return (uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec;
+    }
+
+    // Definition - CaptureWriter
+
+    CaptureWriter::CaptureWriter(std::string const& path, uint32_t const& dataLen, uint32_t const& flags)
+    : file(open(path.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,0644)), header(), blockLen(0), buffer(), bufferPos(0),
+      droppedRecords(0), stop(false), failed(false)
+    {
+        memcpy(header.magic,cCaptureMagic,sizeof(header.magic));
+        header.version = cCaptureVersion;
+        header.flags = flags;
+        header.dataLen = dataLen;
+        header.recordLen = sizeof(uint64_t) + (dataLen+7)/8*8;
+        header.recordCount = 0;
+
+        if(file >= 0 && write(file,&header,sizeof(header)) != sizeof(header))
+        {
+            close(file);
+            file = -1;
+        }
+        if(file < 0)
+            return;
+
+        blockLen = cCaptureBufferLen/header.recordLen*header.recordLen;
+        buffer.resize(blockLen);
+        for(size_t i = 0; i < cCapturePreallocatedBlocks; ++i)
+            freeBlocks.emplace_back(blockLen);
+
+        writer = std::thread(&CaptureWriter::writerTask,this);
+    }
+
+    CaptureWriter::~CaptureWriter()
+    {
+        if(file < 0)
+            return;
+        Flush();
+        {
+            std::lock_guard lock(blocksMutex);
+            stop = true;
+        }
+        blocksCV.notify_one();
+        writer.join();
+        if(droppedRecords > 0)
+            { LogF() << "CaptureWriter: Writing the capture fell behind. " << droppedRecords << " records were dropped."; }
+        close(file);
+    }
+
+    bool CaptureWriter::IsOpen()
+    {
+        return file >= 0 && !failed;
+    }
+
+    void CaptureWriter::Write(std::vector<char> const& data, uint64_t const& timestampNs)
+    {
+        if(file < 0 || failed.load(std::memory_order_relaxed))
+            return;
+
+        auto record = buffer.data()+bufferPos;
+        memcpy(record,&timestampNs,sizeof(timestampNs));
+        memset(record+sizeof(timestampNs),0,header.recordLen-sizeof(timestampNs));
+        memcpy(record+sizeof(timestampNs),data.data(),std::min<size_t>(data.size(),header.dataLen));
+        bufferPos += header.recordLen;
+
+        if(bufferPos >= buffer.size())
+            Flush();
+    }
+
+    void CaptureWriter::Flush()
+    {
+        if(file < 0 || bufferPos == 0)
+            return;
+
+        {
+            std::lock_guard lock(blocksMutex);
+            if(freeBlocks.empty() && fullBlocks.size() >= cCaptureMaxQueuedBlocks)
+            {
+                // file can't keep up, don't let the buffered data grow without limit
+                droppedRecords += bufferPos/header.recordLen;
+                bufferPos = 0;
+                return;
+            }
+            buffer.resize(bufferPos);
+            fullBlocks.push_back(std::move(buffer));
+            if(!freeBlocks.empty())
+            {
+                buffer = std::move(freeBlocks.back());
+                freeBlocks.pop_back();
+            }
+            else
+                buffer = std::vector<char>();
+        }
+        blocksCV.notify_one();
+
+        // allocates only if all preallocated blocks are waiting for writing
+        buffer.resize(blockLen);
+        bufferPos = 0;
+    }
+
+    void CaptureWriter::writerTask()
+    {
+        pthread_setname_np(pthread_self(),"sdgyro-capture");
+
+        std::unique_lock lock(blocksMutex);
+        while(true)
+        {
+            blocksCV.wait(lock,[this]{ return stop || !fullBlocks.empty(); });
+            if(fullBlocks.empty())
+                break;  // stopped and everything is written
+
+            auto block = std::move(fullBlocks.front());
+            fullBlocks.pop_front();
+            lock.unlock();
+
+            if(!failed)
+            {
+                if(write(file,block.data(),block.size()) != (ssize_t)block.size())
+                {
+                    Log("CaptureWriter: Writing the capture failed. Capturing stopped.");
+                    failed = true;
+                }
+                else
+                {
+                    header.recordCount += block.size()/header.recordLen;
+                    pwrite(file,&header,sizeof(header),0);
+                }
+            }
+
+            lock.lock();
+            freeBlocks.push_back(std::move(block));
+        }
+    }
+
+    // Definition - CaptureReader
+
+    CaptureReader::CaptureReader(std::string const& path)
+    : map(nullptr), mapLen(0), count(0), header()
+    {
+        int file = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+        if(file < 0)
+            return;
+
+        struct stat fileStat;
+        if(fstat(file,&fileStat) == 0 && fileStat.st_size >= (off_t)sizeof(header))
+        {
+            mapLen = fileStat.st_size;
+            auto mapped = mmap(nullptr,mapLen,PROT_READ,MAP_PRIVATE | MAP_POPULATE,file,0);
+            if(mapped != MAP_FAILED)
+                map = reinterpret_cast<char const*>(mapped);
+        }
+        close(file);
+
+        if(map == nullptr)
+            return;
+
+        memcpy(&header,map,sizeof(header));
+        if(memcmp(header.magic,cCaptureMagic,sizeof(header.magic)) != 0 
+            || header.version != cCaptureVersion 
+            || header.recordLen < sizeof(uint64_t)+header.dataLen)
+        {
+            munmap(const_cast<char*>(map),mapLen);
+            map = nullptr;
+            return;
+        }
+
+        // records written before an unclean exit are still usable
+        count = (mapLen-sizeof(header))/header.recordLen;
+    }
+
+    CaptureReader::~CaptureReader()
+    {
+        if(map != nullptr)
+            munmap(const_cast<char*>(map),mapLen);
+    }
+
+    bool CaptureReader::IsOpen()
+    {
+        return map != nullptr;
+    }
+
+    uint64_t const& CaptureReader::GetCount()
+    {
+        return count;
+    }
+
+    uint32_t const& CaptureReader::GetDataLen()
+    {
+        return header.dataLen;
+    }
+
+    uint32_t const& CaptureReader::GetFlags()
+    {
+        return header.flags;
+    }
+
+    uint64_t CaptureReader::GetTimestamp(uint64_t const& index)
+    {
+        uint64_t timestamp;
+        memcpy(&timestamp,map+sizeof(header)+index*header.recordLen,sizeof(timestamp));
+        return timestamp;
+    }
+
+    char const* CaptureReader::GetData(uint64_t const& index)
+    {
+        return map+sizeof(header)+index*header.recordLen+sizeof(uint64_t);
+    }
+}
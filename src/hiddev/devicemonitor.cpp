@@ -0,0 +1,140 @@
+#include "hiddev/devicemonitor.h"
+#include "hiddev/hiddevfinder.h"
+#include "log/log.h"
+
+#include <systemd/sd-device.h>
+#include <systemd/sd-event.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <poll.h>
+#include <stdexcept>
+
+using namespace kmicki::log;
+
+namespace kmicki::hiddev
+{
+    static const std::string cHidrawSubsystem = "hidraw";
+
+    DeviceMonitor::DeviceMonitor(uint16_t const& _vId, uint16_t const& _pId)
+    : vId(_vId), pId(_pId), addedFd(eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC)), devices()
+    {
+        if(addedFd < 0)
+            throw std::runtime_error("DeviceMonitor: Failed to create file descriptor.");
+    }
+
+    DeviceMonitor::~DeviceMonitor()
+    {
+        Stop();
+        close(addedFd);
+    }
+
+    int DeviceMonitor::GetAddedFd()
+    {
+        return addedFd;
+    }
+
+    bool DeviceMonitor::TryAdded()
+    {
+        eventfd_t value;
+        return eventfd_read(addedFd,&value) == 0;
+    }
+
+    void DeviceMonitor::FlushPipes()
+    { }
+
+    void DeviceMonitor::FindConnected()
+    {
+        devices.clear();
+
+        sd_device_enumerator *enumerator = NULL;
+        if(sd_device_enumerator_new(&enumerator) < 0)
+            return;
+
+        if(sd_device_enumerator_add_match_subsystem(enumerator,cHidrawSubsystem.c_str(),1) >= 0)
+        {
+            for(auto device = sd_device_enumerator_get_device_first(enumerator); device != NULL; 
+                device = sd_device_enumerator_get_device_next(enumerator))
+            {
+                const char *syspath = NULL;
+                if(IsUsbProduct(device,vId,pId) && sd_device_get_syspath(device,&syspath) >= 0)
+                    devices.insert(syspath);
+            }
+        }
+
+        sd_device_enumerator_unref(enumerator);
+    }
+
+    int DeviceMonitor::HandleEvent(sd_device_monitor *monitor, sd_device *device, void *userdata)
+    {
+        reinterpret_cast<DeviceMonitor*>(userdata)->HandleEvent(device);
+        return 0;
+    }
+
+    void DeviceMonitor::HandleEvent(sd_device *device)
+    {
+        sd_device_action_t action;
+        const char *syspath = NULL;
+        if(sd_device_get_action(device,&action) < 0 || sd_device_get_syspath(device,&syspath) < 0)
+            return;
+
+        if(action == SD_DEVICE_ADD)
+        {
+            // parent devices can be read only while device is connected
+            if(!IsUsbProduct(device,vId,pId))
+                return;
+            devices.insert(syspath);
+            Log("DeviceMonitor: Controller connected.");
+            eventfd_write(addedFd,1);
+        }
+        else if(action == SD_DEVICE_REMOVE)
+        {
+            if(devices.erase(syspath) > 0)
+                Log("DeviceMonitor: Controller disconnected.");
+        }
+    }
+
+    void DeviceMonitor::Execute()
+    {
+        sd_event *event = NULL;
+        sd_device_monitor *monitor = NULL;
+
+        if(sd_event_new(&event) < 0)
+        {
+            Log("DeviceMonitor: Failed to create event loop. Hotplug is not watched.");
+            return;
+        }
+
+        if(sd_device_monitor_new(&monitor) < 0
+            || sd_device_monitor_filter_add_match_subsystem_devtype(monitor,cHidrawSubsystem.c_str(),NULL) < 0
+            || sd_device_monitor_attach_event(monitor,event) < 0
+            || sd_device_monitor_start(monitor,&DeviceMonitor::HandleEvent,this) < 0)
+        {
+            Log("DeviceMonitor: Failed to start monitoring devices. Hotplug is not watched.");
+            sd_device_monitor_unref(monitor);
+            sd_event_unref(event);
+            return;
+        }
+
+        FindConnected();
+
+        Log("DeviceMonitor: Started.",LogLevelDebug);
+
+        // event loop of sd_event is driven here, so that it can be interrupted through wake file descriptor
+        pollfd fileDescriptors[2] = {{sd_event_get_fd(event),POLLIN,0},{GetWakeFd(),POLLIN,0}};
+
+        while(ShouldContinue())
+        {
+            if(poll(fileDescriptors,2,-1) <= 0 || (fileDescriptors[1].revents & POLLIN))
+                continue;
+
+            while(sd_event_run(event,0) > 0)
+                ;
+        }
+
+        sd_device_monitor_stop(monitor);
+        sd_device_monitor_unref(monitor);
+        sd_event_unref(event);
+
+        Log("DeviceMonitor: Stopped.",LogLevelDebug);
+    }
+}
@@ -1,3 +1,5 @@
+#ifndef SDGYRO_NO_HIDAPI
+
 #include "log/log.h"
 #include "hiddev/hidapidev.h"
 #include <iostream>
@@ -80,7 +82,7 @@ namespace kmicki::hiddev
             if(readCntLoc < 0)
                 return readCntLoc;
             if(readCntLoc == 0)
-                return (readCnt==0)?-1:readCnt;
+                return readCnt; // timed out
             readCnt += readCntLoc;
         }
         while(readCnt < data.size());
@@ -119,3 +121,5 @@ namespace kmicki::hiddev
         return Write(cmd);
     }
 }
+
+#endif
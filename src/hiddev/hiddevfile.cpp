@@ -13,13 +13,18 @@ namespace kmicki::hiddev
     static const int cUsToTimeout = 1000;
 
     HidDevFile::HidDevFile(std::string const& _filePath, int readTimeoutUs, bool const& open)
-        : filePath(_filePath), fileDescriptors{{-1,POLLIN,0}}, 
+        : filePath(_filePath), fileDescriptors{{-1,POLLIN,0},{-1,POLLIN,0}}, 
         timeout{0,readTimeoutUs*cUsToTimeout}, file(fileDescriptors[0].fd)
     {
         if(open)
             Open();
     }
 
+    void HidDevFile::SetWakeFd(int wakeFd)
+    {
+        fileDescriptors[1].fd = wakeFd;
+    }
+
     bool HidDevFile::Open()
     {
         file = open(filePath.c_str(),O_RDONLY);
@@ -43,7 +48,7 @@ namespace kmicki::hiddev
         if(file < 0)
             return 0;
         
-        auto retval = ppoll(fileDescriptors,1,&timeout,nullptr);
+        auto retval = ppoll(fileDescriptors,2,&timeout,nullptr);
         
         if(retval == 0)
             return 0;
@@ -51,6 +56,9 @@ namespace kmicki::hiddev
         if(retval < 0)
             return retval;
 
+        if(fileDescriptors[1].revents & POLLIN)
+            return 0;
+
         int readCnt = 0;
             
         do {
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <iomanip>
 #include <filesystem>
+#include <cstdlib>
 #include <systemd/sd-device.h>
     
 using namespace kmicki::shell;
@@ -13,6 +14,10 @@ namespace kmicki::hiddev
     const std::string cHiddevPrefix = std::string("hiddev");
     const std::string cSubsystem = "usb";
     const std::string cDevType = "usb_device";
+    const std::string cHidrawPath = "/dev/";
+    const std::string cHidrawPrefix = std::string("hidraw");
+    const std::string cInterfaceDevType = "usb_interface";
+    const std::string cInterfaceNumberAttrName = "bInterfaceNumber";
     const std::string cProductPropertyName = "PRODUCT";
 
     inline std::string GetHexStringId(uint16_t id)
@@ -66,4 +71,64 @@ namespace kmicki::hiddev
 
         return -1;
     }
+
+    // Check if USB device that sd_device belongs to matches provided vendor ID and product ID.
+    bool IsUsbProduct(sd_device *device, std::string const& vidStr, std::string const& pidStr)
+    {
+        sd_device *usbDevice = NULL;
+        if(sd_device_get_parent_with_subsystem_devtype(device,cSubsystem.c_str(),cDevType.c_str(),&usbDevice) != 0)
+            return false;
+
+        const char *product = NULL;
+        if(sd_device_get_property_value(usbDevice,cProductPropertyName.c_str(),&product) != 0)
+            return false;
+
+        return vidStr == std::string(product).substr(0,4) && pidStr == std::string(product).substr(5,4);
+    }
+
+    bool IsUsbProduct(sd_device *device, uint16_t vid, uint16_t pid)
+    {
+        return IsUsbProduct(device,GetHexStringId(vid),GetHexStringId(pid));
+    }
+
+    // Find N of the hidraw device matching provided vendor ID, product ID and USB interface number.
+    // N being the number in path: /dev/hidrawN
+    int FindHidRawNo(uint16_t vid, uint16_t pid, int interfaceNumber)
+    {
+        auto vidStr = GetHexStringId(vid);
+        auto pidStr = GetHexStringId(pid);
+
+        // Loop through all /dev/hidraw* files
+        for (const auto & hidrawFile : std::filesystem::directory_iterator(cHidrawPath))
+        {
+            std::string fName = hidrawFile.path().filename();
+            if(fName.length() <= cHidrawPrefix.length() || fName.compare(0,cHidrawPrefix.length(),cHidrawPrefix) != 0)
+                continue;
+
+            sd_device *hidrawDevice = NULL;
+            if(sd_device_new_from_devname(&hidrawDevice, hidrawFile.path().c_str()) != 0)
+                continue;
+
+            // Go up to usb_interface and check its number
+            sd_device *interfaceDevice = NULL;
+            const char *interfaceNo = NULL;
+            bool matches = sd_device_get_parent_with_subsystem_devtype(hidrawDevice,cSubsystem.c_str(),cInterfaceDevType.c_str(),&interfaceDevice) == 0
+                        && sd_device_get_sysattr_value(interfaceDevice,cInterfaceNumberAttrName.c_str(),&interfaceNo) == 0
+                        && std::strtol(interfaceNo,nullptr,16) == interfaceNumber
+                        && IsUsbProduct(interfaceDevice,vidStr,pidStr);
+
+            sd_device_unref(hidrawDevice);
+
+            if(!matches)
+                continue;
+
+            std::string strNum = fName.substr(cHidrawPrefix.length());
+            std::stringstream ss(strNum);
+            int i;
+            if(!(ss >> i).fail() && (ss >> std::ws).eof())
+                return i; // found matching hidraw file
+        }
+
+        return -1;
+    }
 }
\ No newline at end of file
@@ -1,50 +1,39 @@
 #include "hiddev/hiddevreader.h"
+#include "hiddev/hiddevrecords.h"
 #include "log/log.h"
 
 #include <sstream>
+#include <cstring>
 
 using namespace kmicki::log;
 
 namespace kmicki::hiddev
 {
     // Constants
-    const int HidDevReader::cInputRecordLen = 8;    // Number of bytes that are read from hiddev file per 1 byte of HID data.
-    const int HidDevReader::cByteposInput = 4;      // Position in the raw hiddev record (of INPUT_RECORD_LEN length) where 
-                                                    // HID data byte is.
+    const int HidDevReader::cInputRecordLen = cRecordLen;       // Number of bytes that are read from hiddev file per 1 byte of HID data.
+    const int HidDevReader::cByteposInput = cRecordBytePos;     // Position in the raw hiddev record (of INPUT_RECORD_LEN length) where 
+                                                                // HID data byte is.
+    const int HidDevReader::cFrameIdPos = 4;                    // Position in the HID frame of 32-bit frame counter.
+    const int HidDevReader::cServeDepth = 16;                   // Number of most recent frames kept for consumers that fall behind.
+    const int HidDevReader::cReplayOriginalTiming = -1;
 
-    void HandleMissedTicks(std::string name, std::string tickName, bool received, int & ticks, int period, int & nonMissed)
+    // Definition - HidDevReader
+
+    uint32_t HidDevReader::GetFrameId(frame_t const& frame)
     {
-        if(GetLogLevel() < LogLevelDebug)
-            return;
-        if(!received)
-        {
-            if(ticks == 1)
-                { LogF(LogLevelDebug) << name << ": Start missing " << tickName << "."; }
-            ++ticks;
-            if(ticks % period == 0)
-            {
-                { LogF(LogLevelDebug) << name << ": Missed " << period << " " << tickName << " after " << nonMissed << " " << tickName << ". Still being missed."; }
-                if(ticks > period)
-                    ticks -= period;
-            }
-        }
-        else if(ticks > period)
-        {
-            { LogF(LogLevelDebug) << name << ": Missed " << ((ticks+1) % period - 1) << " " << tickName << ". Not being missed anymore."; }
-            ticks = 0;
-            nonMissed = 0;
-        }
-        else if(ticks > 0)
-        {
-            { LogF(LogLevelDebug) << name << ": Missed " << ticks << " " << tickName << " after " << nonMissed << " " << tickName << "."; }
-            ticks = 0;
-            nonMissed = 0;
-        }
-        else
-            ++nonMissed;
+        uint32_t id;
+        memcpy(&id,frame.data()+cFrameIdPos,sizeof(id));
+        return id;
     }
 
-    // Definition - HidDevReader
+    uint32_t HidDevReader::GetRecordsFrameId(std::vector<char> const& records)
+    {
+        uint32_t id;
+        auto bytes = reinterpret_cast<char*>(&id);
+        for(int i = 0, j = cByteposInput+cFrameIdPos*cInputRecordLen; i < sizeof(id); ++i, j += cInputRecordLen)
+            bytes[i] = records[j];
+        return id;
+    }
 
     void HidDevReader::AddOperation(Thread * operation)
     {
@@ -54,15 +43,16 @@ namespace kmicki::hiddev
     void HidDevReader::ConstructPipeline(ReadData *_readData, int const& _frameLen, int const& scanTimeUs, bool useProcessData)
     {
         auto* readDataOp = _readData;
-        ProcessData* processData;
         ServeFrame* serveFrame;
+        processData = nullptr;
         if(useProcessData)
         {
             processData = new ProcessData(_frameLen, *readDataOp, scanTimeUs);
-            serveFrame = new ServeFrame(processData->Frame);
+            { LogF(LogLevelDebug) << "HidDevReader: Extracting hiddev records with " << GetRecordKernelName() << " kernel."; }
+            serveFrame = new ServeFrame(processData->Frame, cServeDepth);
         }
         else
-            serveFrame = new ServeFrame(readDataOp->Data);
+            serveFrame = new ServeFrame(readDataOp->Data, cServeDepth);
 
         AddOperation(readDataOp);
         if(useProcessData)
@@ -76,7 +66,7 @@ namespace kmicki::hiddev
     }
 
     HidDevReader::HidDevReader(int const& hidNo, int const& _frameLen, int const& scanTimeUs) 
-    : frameLen(_frameLen), startStopMutex(), readDataApi(nullptr)
+    : frameLen(_frameLen), startStopMutex()
     {
         if(hidNo < 0) throw std::invalid_argument("hidNo");
 
@@ -89,26 +79,65 @@ namespace kmicki::hiddev
     }
 
 
-    HidDevReader::HidDevReader(uint16_t const& vId, uint16_t const& pId, int const& interfaceNumber ,int const& _frameLen, int const& scanTimeUs) 
+    HidDevReader::HidDevReader(uint16_t const& vId, uint16_t const& pId, int const& interfaceNumber ,int const& _frameLen, int const& scanTimeUs, bool const& hidApi) 
     : frameLen(_frameLen), startStopMutex()
     {
-        readDataApi = new ReadDataApi(vId, pId, interfaceNumber, _frameLen, scanTimeUs);
+        ReadData* readDataOp;
+#ifndef SDGYRO_NO_HIDAPI
+        if(hidApi)
+            readDataOp = new ReadDataApi(vId, pId, interfaceNumber, _frameLen, scanTimeUs);
+        else
+#else
+        if(hidApi)
+            Log("HidDevReader: Built without hidapi. Reading hidraw file directly.");
+#endif
+            readDataOp = new ReadDataRaw(vId, pId, interfaceNumber, _frameLen, scanTimeUs);
 
-        ConstructPipeline(readDataApi, _frameLen, scanTimeUs,false);
+        monitor.reset(new DeviceMonitor(vId, pId));
+        readDataOp->SetDeviceMonitor(*monitor);
+
+        ConstructPipeline(readDataOp, _frameLen, scanTimeUs,false);
     }
 
 
+    HidDevReader::HidDevReader(std::string const& capturePath, int const& replayPeriodUs, int const& scanTimeUs)
+    : startStopMutex()
+    {
+        std::unique_ptr<CaptureReader> replay(new CaptureReader(capturePath));
+        if(!replay->IsOpen())
+            throw std::runtime_error("HidDevReader: Capture file could not be opened or has wrong format.");
+
+        bool hiddevRecords = (replay->GetFlags() & CaptureFlagHiddevRecords) != 0;
+        frameLen = hiddevRecords ? replay->GetDataLen()/cInputRecordLen : replay->GetDataLen();
+
+        { LogF() << "HidDevReader: Replaying " << replay->GetCount() << " records from " << capturePath << "."; }
+
+        auto* readDataOp = new ReadDataReplay(std::move(replay), replayPeriodUs);
+        ConstructPipeline(readDataOp, frameLen, scanTimeUs, hiddevRecords);
+    }
+
+    HidDevReader::HidDevReader(SyntheticParams const& params, int const& _frameLen)
+    : frameLen(_frameLen), startStopMutex()
+    {
+        { LogF() << "HidDevReader: Generating synthetic frames at " << params.rate << " Hz."; }
+
+        auto* readDataOp = new ReadDataSynthetic(params, _frameLen);
+        ConstructPipeline(readDataOp, _frameLen, (int)(1000000/params.rate), false);
+    }
+
     HidDevReader::~HidDevReader()
     {
-        Stop();
+        std::lock_guard startLock(startStopMutex);
+        startCount = 0;
+        StopPipeline();
     }
 
-    Serve<HidDevReader::frame_t> & HidDevReader::GetServe()
+    HidDevReader::serve_t & HidDevReader::GetServe()
     {
         return serve->GetServe();
     }
 
-    void HidDevReader::StopServe(Serve<frame_t> & _serve)
+    void HidDevReader::StopServe(serve_t & _serve)
     {
         serve->StopServe(_serve);
     }
@@ -124,8 +153,14 @@ namespace kmicki::hiddev
     {
         std::lock_guard startLock(startStopMutex); // prevent starting and stopping at the same time
 
+        if(startCount++ > 0)
+            return;
+
         Log("HidDevReader: Attempting to start the pipeline...",LogLevelDebug);
 
+        if(monitor)
+            monitor->Start();
+
         for (auto& thread : pipeline)
             thread->Start();
 
@@ -136,10 +171,24 @@ namespace kmicki::hiddev
     {
         std::lock_guard startLock(startStopMutex); // prevent starting and stopping at the same time
 
+        if(startCount == 0 || --startCount > 0)
+            return;
+
+        StopPipeline();
+    }
+
+    void HidDevReader::StopPipeline()
+    {
         Log("HidDevReader: Attempting to stop the pipeline...",LogLevelDebug);
 
         for (auto thread = pipeline.rbegin(); thread != pipeline.rend(); ++thread)
-            (*thread)->TryStopThenKill(std::chrono::seconds(10));
+            (*thread)->Stop();
+
+        if(monitor)
+            monitor->Stop();
+
+        if(capture)
+            capture->Flush();
 
         Log("HidDevReader: Stopped the pipeline.");
     }
@@ -165,9 +214,35 @@ namespace kmicki::hiddev
         return false;
     }
 
+    bool HidDevReader::SetCapture(std::string const& capturePath)
+    {
+        std::lock_guard startLock(startStopMutex);
+
+        // data are in hiddev format if they need processing into HID frames
+        uint32_t flags = (processData != nullptr) ? CaptureFlagHiddevRecords : 0;
+        capture.reset(new CaptureWriter(capturePath, readData->Data.GetPointerToFill()->size(), flags));
+        if(!capture->IsOpen())
+        {
+            capture.reset();
+            readData->SetCapture(nullptr);
+            return false;
+        }
+        readData->SetCapture(capture.get());
+        { LogF() << "HidDevReader: Capturing data into " << capturePath << "."; }
+        return true;
+    }
+
+    void HidDevReader::SetRealtimeProfile(RealtimeProfile const& read, RealtimeProfile const& process, RealtimeProfile const& serve)
+    {
+        readData->SetRealtimeProfile("sdgyro-read",read);
+        if(processData)
+            processData->SetRealtimeProfile("sdgyro-process",process);
+        this->serve->SetRealtimeProfile("sdgyro-serve",serve);
+    }
+
     void HidDevReader::SetNoGyro(SignalOut &_noGyro)
     {
-        if(readDataApi)
-            readDataApi->SetNoGyro(_noGyro);
+        if(readData)
+            readData->SetNoGyro(_noGyro);
     }
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "hiddev/hiddevreader.h"
+#include "hiddev/hiddevrecords.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
 
 using namespace kmicki::log;
 
@@ -14,44 +17,37 @@ namespace kmicki::hiddev
 
     HidDevReader::ProcessData::~ProcessData()
     {
-        TryStopThenKill();
+        Stop();
     }
 
     void HidDevReader::ProcessData::Execute()
     {
-        static const std::chrono::microseconds cReadDataRestartTimeout(500);
-        static const int cReportMissedTicksPeriod = 250;
-        int missedTicks = 0;
-        int nonMissedTicks = 0;
-        
         auto const& frame = Frame.GetPointerToFill();
         auto const& hidData = data.GetPointer();
 
-        int missedLossTicks = 0;
-        int nonMissedLossTicks = 0;
-
         Log("HidDevReader::ProcessData: Started.",LogLevelDebug);
 
         while(ShouldContinue())
         {
             if(!data.WaitForData(timeout))
             {
-                Log("HidDevReader::ProcessData: Reading from hiddev file stuck. Force-restarting reading task.",LogLevelDebug);
+                Log("HidDevReader::ProcessData: Reading from hiddev file stuck. Restarting reading task.",LogLevelDebug);
                 ReadStuck.SendSignal();
-                readData.TryRestartThenForceRestart(cReadDataRestartTimeout);
+                readData.Restart();
                 continue;
             }
             if(!ShouldContinue())
                 break;
 
             // Each byte is encapsulated in a record
-            for (int i = 0, j = cByteposInput; i < frame->size(); ++i,j+=cInputRecordLen) 
-            {
-                (*frame)[i] = (*hidData)[j];
-            }
+            ExtractRecordBytes(hidData->data(),frame->data(),frame->size());
+            frame->Timestamp = hidData->Timestamp;
             
-            HandleMissedTicks("HidDevReader::ProcessData","frames",Frame.WasReceived(),missedTicks,cReportMissedTicksPeriod,nonMissedLossTicks);
+            stats::Add(stats::CounterProcessFrames);
+            if(!Frame.WasReceived())
+                stats::Add(stats::CounterProcessDropped);
 
+            trace::Stamp(trace::PointProcess,GetFrameId(*frame));
             Frame.SendData();
         }
         
@@ -60,6 +56,6 @@ namespace kmicki::hiddev
 
     void HidDevReader::ProcessData::FlushPipes()
     {
-        data.SendData();
+        data.Flush();
     }
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "hiddev/hiddevreader.h"
 #include "log/log.h"
+#include "stats/stats.h"
 #include <fcntl.h>
 #include <sys/select.h>
+#include <poll.h>
 
 using namespace kmicki::log;
 
@@ -9,16 +11,16 @@ namespace kmicki::hiddev
 {
     // Definition - ReadData
     HidDevReader::ReadData::ReadData(int const& _frameLen)
-    : startMarker(0),
-      Data(new std::vector<char>(_frameLen),
-           new std::vector<char>(_frameLen), 
-           new std::vector<char>(_frameLen)),
+    : startMarker(0), noGyro(nullptr), monitor(nullptr), capture(nullptr),
+      Data(new frame_t(_frameLen),
+           new frame_t(_frameLen), 
+           new frame_t(_frameLen)),
       Unsynced()
     { }
 
     HidDevReader::ReadData::~ReadData()
     {
-        TryStopThenKill();
+        Stop();
     }
 
     void HidDevReader::ReadData::FlushPipes()
@@ -28,4 +30,46 @@ namespace kmicki::hiddev
     {
         startMarker = marker;
     }
+
+    void HidDevReader::ReadData::SetNoGyro(SignalOut &_noGyro)
+    {
+        noGyro = &_noGyro;
+    }
+
+    void HidDevReader::ReadData::SetDeviceMonitor(DeviceMonitor &_monitor)
+    {
+        monitor = &_monitor;
+    }
+
+    void HidDevReader::ReadData::SetCapture(CaptureWriter* _capture)
+    {
+        capture = _capture;
+    }
+
+    void HidDevReader::ReadData::SendData()
+    {
+        auto const& data = Data.GetPointerToFill();
+        data->Timestamp = GetMonotonicNs();
+        if(capture != nullptr)
+            capture->Write(*data,data->Timestamp);
+        stats::Add(stats::CounterReadFrames);
+        if(!Data.WasReceived())
+            stats::Add(stats::CounterReadDropped);
+        Data.SendData();
+    }
+
+    void HidDevReader::ReadData::WaitForDevice()
+    {
+        static const int cRetryPeriodMs = 1000;
+        static const int cMonitoredRetryPeriodMs = 5000;   // fallback in case an event is missed
+
+        pollfd fileDescriptors[2] = {{GetWakeFd(),POLLIN,0},{-1,POLLIN,0}};
+        if(monitor != nullptr)
+            fileDescriptors[1].fd = monitor->GetAddedFd();
+
+        poll(fileDescriptors,2,(monitor != nullptr)?cMonitoredRetryPeriodMs:cRetryPeriodMs);
+
+        if(monitor != nullptr)
+            monitor->TryAdded();
+    }
 }
\ No newline at end of file
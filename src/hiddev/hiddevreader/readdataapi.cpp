@@ -1,6 +1,10 @@
+#ifndef SDGYRO_NO_HIDAPI
+
 #include "hiddev/hiddevreader.h"
 #include "hiddev/hidapidev.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
 #include <hidapi/hidapi.h>
 
 using namespace kmicki::log;
@@ -11,13 +15,8 @@ namespace kmicki::hiddev
 
     // Definition - ReadDataApi
     HidDevReader::ReadDataApi::ReadDataApi(uint16_t const& _vId, uint16_t const& _pId, const int& _interfaceNumber, int const& _frameLen, int const& _scanTimeUs)
-    : vId(_vId), pId(_pId), ReadData(_frameLen), timeout(cApiScanTimeToTimeout*_scanTimeUs/1000),interfaceNumber(_interfaceNumber),noGyro(nullptr)
+    : vId(_vId), pId(_pId), ReadData(_frameLen), timeout(cApiScanTimeToTimeout*_scanTimeUs/1000),interfaceNumber(_interfaceNumber)
     { }
-
-    void HidDevReader::ReadDataApi::SetNoGyro(SignalOut &_noGyro)
-    {
-        noGyro = &_noGyro;
-    }
  
     void HidDevReader::ReadDataApi::Execute()
     {
@@ -25,7 +24,7 @@ namespace kmicki::hiddev
         
         Log("HidDevReader::ReadDataApi: Opening HID device.",LogLevelDebug);
         if(!dev.Open())
-            throw std::runtime_error("HidDevReader::ReadDataApi: Problem opening HID device.");
+            Log("HidDevReader::ReadDataApi: HID device not available. Waiting for it to be connected.");
 
         auto const& data = Data.GetPointerToFill();
 
@@ -33,24 +32,34 @@ namespace kmicki::hiddev
 
         while(ShouldContinue())
         {
-            if(!ShouldContinue())
-                break;
+            if(!dev.IsOpen())
+            {
+                WaitForDevice();
+                if(ShouldContinue() && dev.Open())
+                    Log("HidDevReader::ReadDataApi: HID device opened.");
+                continue;
+            }
 
             if(noGyro && noGyro->TrySignal())
             {
                 Log("HidDevReader::ReadDataApi: Try reenabling gyro.",LogLevelTrace);
+                stats::Add(stats::CounterReadGyroEnable);
                 if(dev.EnableGyro())
                     Log("HidDevReader::ReadDataApi: Gyro reenabled.",LogLevelDebug);
                 else
+                {
+                    stats::Add(stats::CounterReadGyroEnableFailed);
                     Log("HidDevReader::ReadDataApi: Gyro reenaling failed.");
+                }
                 continue;
             }
 
             auto readCnt = dev.Read(*data);
 
-            if(readCnt < data->size())
+            if(readCnt < 0)
             {
-                { LogF(LogLevelTrace) << "HidDevReader::ReadDataApi: Not enough bytes read: " << readCnt << "."; }
+                Log("HidDevReader::ReadDataApi: Reading HID device failed. Closing it.");
+                dev.Close();
                 continue;
             }
 
@@ -60,7 +69,15 @@ namespace kmicki::hiddev
                 continue;
             }
 
-            Data.SendData();
+            if(readCnt < data->size())
+            {
+                { LogF(LogLevelTrace) << "HidDevReader::ReadDataApi: Not enough bytes read: " << readCnt << "."; }
+                stats::Add(stats::CounterReadUnsynced);
+                continue;
+            }
+
+            trace::Stamp(trace::PointRead,GetFrameId(*data));
+            SendData();
         }
     
         Log("HidDevReader::ReadDataApi: Closing HID device.",LogLevelDebug);
@@ -68,4 +85,6 @@ namespace kmicki::hiddev
         
         Log("HidDevReader::ReadDataApi: Stopped.",LogLevelDebug);
     }
-}
\ No newline at end of file
+}
+
+#endif
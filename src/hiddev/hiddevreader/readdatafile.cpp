@@ -1,5 +1,8 @@
 #include "hiddev/hiddevreader.h"
+#include "hiddev/hiddevrecords.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
 #include <fcntl.h>
 #include <sys/select.h>
 
@@ -12,7 +15,9 @@ namespace kmicki::hiddev
     // Definition - ReadDataFile
     HidDevReader::ReadDataFile::ReadDataFile(std::string const& _inputFilePath, int const& _frameLen, int const& _scanTimeUs)
     : inputFile(_inputFilePath,cFileScanTimeToTimeout*_scanTimeUs,false), ReadData(_frameLen*HidDevReader::cInputRecordLen)
-    { }
+    {
+        inputFile.SetWakeFd(GetWakeFd());
+    }
 
     void HidDevReader::ReadDataFile::ReconnectInput()
     {
@@ -30,17 +35,8 @@ namespace kmicki::hiddev
         }
     }
 
-    uint32_t const& ExtractFirst4Bytes(std::vector<char> const& data)
-    {
-        return *(reinterpret_cast<uint32_t const*>(data.data()));
-    }
- 
     void HidDevReader::ReadDataFile::Execute()
     {
-        static const int cReportMissedTicksPeriod = 250;
-        int missedTicks = 0;
-        int nonMissedTicks = 0;
-
         ReconnectInput();
         if(!inputFile.IsOpen())
         {
@@ -62,45 +58,25 @@ namespace kmicki::hiddev
 
             if(readCnt == 0)
             {
-                Log("HidDevReader::ReadDataFile: Waiting for data timed out.",LogLevelTrace);
+                Log("HidDevReader::ReadDataFile: Waiting for data timed out or interrupted.",LogLevelTrace);
                 continue;
             }
 
             if(!CheckData(data,readCnt))
                 continue;
 
-            HandleMissedTicks("HidDevReader::ReadData","HID frames",Data.WasReceived(),missedTicks,cReportMissedTicksPeriod,nonMissedTicks);
-
-            Data.SendData();
+            trace::Stamp(trace::PointRead,GetRecordsFrameId(*data));
+            SendData();
         }
 
         DisconnectInput();
         Log("HidDevReader::ReadDataFile: Stopped.",LogLevelDebug);
     }
 
-    bool HidDevReader::ReadDataFile::CheckData(std::unique_ptr<std::vector<char>> const& data, ssize_t readCnt)
+    bool HidDevReader::ReadDataFile::CheckData(std::unique_ptr<frame_t> const& data, ssize_t readCnt)
     {
-        static const uint32_t cFirst4Bytes = 0xFFFF0002;
-        static const uint32_t cFirst4BytesAlternative = 0xFFFF0001;
-
         bool inputFail = readCnt < data->size();
-        bool startMarkerFail = false;
-
-        if(!inputFail)
-        {
-            startMarkerFail = ExtractFirst4Bytes(*data) != cFirst4Bytes;
-            if(startMarkerFail && startMarker.size() > 0 && ExtractFirst4Bytes(*data) == cFirst4BytesAlternative)
-            {
-                startMarkerFail = false;
-                // Check special start marker
-                for(int i = cByteposInput, j=0;j<startMarker.size();++j,i+=cInputRecordLen)
-                    if(startMarker[j] != (*data)[i])
-                    {
-                        startMarkerFail = true;
-                        break;
-                    }
-            }
-        }
+        bool startMarkerFail = !inputFail && !IsRecordsFrameStart(data->data(),startMarker.data(),startMarker.size());
 
         if(inputFail || startMarkerFail)
         {
@@ -110,6 +86,7 @@ namespace kmicki::hiddev
                 Log("HidDevReader::ReadDataFile: Reading from hiddev file started in the middle of the HID frame.",LogLevelDebug);
             // Failed to read a frame
             // or start in the middle of the input frame
+            stats::Add(stats::CounterReadUnsynced);
             ReconnectInput();
             Unsynced.SendSignal();
             return false;
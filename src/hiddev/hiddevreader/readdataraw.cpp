@@ -0,0 +1,105 @@
+#include "hiddev/hiddevreader.h"
+#include "hiddev/hidrawdev.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
+#include <poll.h>
+
+using namespace kmicki::log;
+
+namespace kmicki::hiddev
+{
+    static const int cRawScanTimeToTimeout = 2;
+
+    // Definition - ReadDataRaw
+    HidDevReader::ReadDataRaw::ReadDataRaw(uint16_t const& _vId, uint16_t const& _pId, const int& _interfaceNumber, int const& _frameLen, int const& _scanTimeUs)
+    : vId(_vId), pId(_pId), ReadData(_frameLen), timeout(cRawScanTimeToTimeout*_scanTimeUs/1000),interfaceNumber(_interfaceNumber)
+    { }
+ 
+    void HidDevReader::ReadDataRaw::Execute()
+    {
+        HidRawDev dev(vId,pId,interfaceNumber);
+        
+        Log("HidDevReader::ReadDataRaw: Opening HID device.",LogLevelDebug);
+        if(dev.Open())
+            { LogF(LogLevelDebug) << "HidDevReader::ReadDataRaw: Opened " << dev.GetPath() << "."; }
+        else
+            Log("HidDevReader::ReadDataRaw: HID device not available. Waiting for it to be connected.");
+
+        // device file and wake file descriptor (interrupts waiting when thread is stopped)
+        pollfd fileDescriptors[2] = {{dev.GetFd(),POLLIN,0},{GetWakeFd(),POLLIN,0}};
+
+        auto const& data = Data.GetPointerToFill();
+
+        Log("HidDevReader::ReadDataRaw: Started.",LogLevelDebug);
+
+        while(ShouldContinue())
+        {
+            if(noGyro && noGyro->TrySignal())
+            {
+                Log("HidDevReader::ReadDataRaw: Try reenabling gyro.",LogLevelTrace);
+                stats::Add(stats::CounterReadGyroEnable);
+                if(dev.EnableGyro())
+                    Log("HidDevReader::ReadDataRaw: Gyro reenabled.",LogLevelDebug);
+                else
+                {
+                    stats::Add(stats::CounterReadGyroEnableFailed);
+                    Log("HidDevReader::ReadDataRaw: Gyro reenaling failed.");
+                }
+                continue;
+            }
+
+            if(!dev.IsOpen())
+            {
+                WaitForDevice();
+                if(!ShouldContinue() || !dev.Open())
+                    continue;
+                fileDescriptors[0].fd = dev.GetFd();
+                { LogF() << "HidDevReader::ReadDataRaw: Opened " << dev.GetPath() << "."; }
+            }
+
+            auto ready = poll(fileDescriptors,2,timeout);
+
+            if(ready == 0)
+            {
+                Log("HidDevReader::ReadDataRaw: Waiting for data timed out.",LogLevelTrace);
+                continue;
+            }
+
+            if(ready < 0 || (fileDescriptors[1].revents & POLLIN))
+                continue;
+
+            if(fileDescriptors[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                Log("HidDevReader::ReadDataRaw: HID device disconnected.");
+                dev.Close();
+                continue;
+            }
+
+            // report is read straight into the buffer that is sent next
+            auto readCnt = dev.Read(*data);
+
+            if(readCnt < 0)
+            {
+                Log("HidDevReader::ReadDataRaw: Reading HID device failed.");
+                dev.Close();
+                continue;
+            }
+
+            if(readCnt < data->size())
+            {
+                { LogF(LogLevelTrace) << "HidDevReader::ReadDataRaw: Not enough bytes read: " << readCnt << "."; }
+                stats::Add(stats::CounterReadUnsynced);
+                continue;
+            }
+
+            trace::Stamp(trace::PointRead,GetFrameId(*data));
+            SendData();
+        }
+    
+        Log("HidDevReader::ReadDataRaw: Closing HID device.",LogLevelDebug);
+        dev.Close();
+        
+        Log("HidDevReader::ReadDataRaw: Stopped.",LogLevelDebug);
+    }
+}
@@ -0,0 +1,82 @@
+#include "hiddev/hiddevreader.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include <poll.h>
+#include <cstring>
+
+using namespace kmicki::log;
+
+namespace kmicki::hiddev
+{
+    static const uint64_t cReplayMaxGapNs = 100000000;  // longer gaps in the capture (pipeline was stopped) are skipped
+
+    // Definition - ReadDataReplay
+    HidDevReader::ReadDataReplay::ReadDataReplay(std::unique_ptr<CaptureReader> && _replay, int const& _periodUs)
+    : ReadData(_replay->GetDataLen()), replay(std::move(_replay)), periodUs(_periodUs)
+    { }
+
+    bool HidDevReader::ReadDataReplay::WaitUntil(uint64_t const& timeNs)
+    {
+        pollfd wake = {GetWakeFd(),POLLIN,0};
+
+        while(true)
+        {
+            auto now = GetMonotonicNs();
+            if(now >= timeNs)
+                return true;
+            auto left = timeNs-now;
+            timespec timeout = { (time_t)(left/1000000000), (long)(left%1000000000) };
+            if(ppoll(&wake,1,&timeout,nullptr) > 0)
+                return false;
+        }
+    }
+ 
+    void HidDevReader::ReadDataReplay::Execute()
+    {
+        bool hiddevRecords = (replay->GetFlags() & CaptureFlagHiddevRecords) != 0;
+        auto const& count = replay->GetCount();
+
+        if(count == 0)
+        {
+            Log("HidDevReader::ReadDataReplay: Capture is empty.");
+            return;
+        }
+
+        auto const& data = Data.GetPointerToFill();
+
+        Log("HidDevReader::ReadDataReplay: Started.",LogLevelDebug);
+
+        auto next = GetMonotonicNs();
+        uint64_t index = 0;
+        uint64_t loops = 0;
+
+        while(ShouldContinue())
+        {
+            if(periodUs != 0 && !WaitUntil(next))
+                continue;
+
+            memcpy(data->data(),replay->GetData(index),data->size());
+
+            trace::Stamp(trace::PointRead,hiddevRecords ? GetRecordsFrameId(*data) : GetFrameId(*data));
+            SendData();
+
+            if(++index >= count)
+            {
+                index = 0;
+                ++loops;
+                { LogF(LogLevelDebug) << "HidDevReader::ReadDataReplay: Replayed capture " << loops << " times. Starting over."; }
+            }
+
+            if(periodUs > 0)
+                next += (uint64_t)periodUs*1000;
+            else if(periodUs < 0)
+            {
+                // keep original spacing of records
+                auto gap = (index == 0) ? 0 : replay->GetTimestamp(index)-replay->GetTimestamp(index-1);
+                next += (gap > cReplayMaxGapNs) ? 0 : gap;
+            }
+        }
+
+        Log("HidDevReader::ReadDataReplay: Stopped.",LogLevelDebug);
+    }
+}
@@ -0,0 +1,102 @@
+#include "hiddev/hiddevreader.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include <poll.h>
+#include <cstring>
+#include <cmath>
+#include <random>
+
+using namespace kmicki::log;
+
+namespace kmicki::hiddev
+{
+    // Layout of Steam Deck controls' HID frame (see sdgyrodsu::SdHidFrame)
+    static const char cSyntheticHeader[] = { 0x01, 0x00, 0x09, 0x40 };
+    static const int cSyntheticAccelPos = 24;   // 3 x int16: right to left, top to bottom, front to back
+    static const int cSyntheticGyroPos = 30;    // 3 x int16: right to left, top to bottom, front to back
+    static const int16_t cSyntheticAccel1G = 0x4000;
+
+    // Definition - ReadDataSynthetic
+    HidDevReader::ReadDataSynthetic::ReadDataSynthetic(SyntheticParams const& _params, int const& _frameLen)
+    : ReadData(_frameLen), params(_params)
+    { }
+
+    void HidDevReader::ReadDataSynthetic::Generate(std::vector<char> & frame, uint32_t const& increment, uint64_t const& n, bool const& zero)
+    {
+        memset(frame.data(),0,frame.size());
+        memcpy(frame.data(),cSyntheticHeader,sizeof(cSyntheticHeader));
+        memcpy(frame.data()+cFrameIdPos,&increment,sizeof(increment));
+
+        if(zero)
+            return;
+
+        // slow rotation around vertical axis, device lying flat
+        double phase = (double)n/params.rate;
+        int16_t accel[3] = { 0, cSyntheticAccel1G, 0 };
+        int16_t gyro[3] = { 0, (int16_t)(1600*std::sin(phase)), (int16_t)(200*std::cos(3*phase)) };
+        memcpy(frame.data()+cSyntheticAccelPos,accel,sizeof(accel));
+        memcpy(frame.data()+cSyntheticGyroPos,gyro,sizeof(gyro));
+    }
+ 
+    void HidDevReader::ReadDataSynthetic::Execute()
+    {
+        std::mt19937 random(params.seed);
+        std::uniform_real_distribution<double> chance(0.0,1.0);
+        std::uniform_int_distribution<int> gap(1,params.maxGap > 0 ? params.maxGap : 1);
+        std::uniform_int_distribution<int> jitter(-params.jitterUs,params.jitterUs);
+
+        auto const& data = Data.GetPointerToFill();
+        pollfd wake = {GetWakeFd(),POLLIN,0};
+
+        uint64_t periodNs = (uint64_t)(1e9/params.rate);
+        uint64_t start = GetMonotonicNs();
+        uint64_t n = 0;
+        uint32_t increment = params.startIncrement;
+        int burst = params.burst > 0 ? params.burst : 1;
+        int toSkip = 0;
+
+        Log("HidDevReader::ReadDataSynthetic: Started.",LogLevelDebug);
+
+        while(ShouldContinue())
+        {
+            // frames of a burst are delivered together at the time of the last one
+            auto due = start + (n+burst-1)*periodNs + (int64_t)jitter(random)*1000;
+            auto now = GetMonotonicNs();
+            if(due > now)
+            {
+                timespec timeout = { (time_t)((due-now)/1000000000), (long)((due-now)%1000000000) };
+                if(ppoll(&wake,1,&timeout,nullptr) > 0)
+                    continue;
+            }
+
+            for(int i = 0; i < burst && ShouldContinue(); ++i, ++n)
+            {
+                // skipped frames are not delivered, but their time passes
+                if(toSkip == 0 && params.gapProbability > 0 && chance(random) < params.gapProbability)
+                    toSkip = gap(random);
+                if(toSkip > 0)
+                {
+                    --toSkip;
+                    ++increment;
+                    continue;
+                }
+
+                bool zero = params.zeroProbability > 0 && chance(random) < params.zeroProbability;
+                Generate(*data,increment,n,zero);
+
+                int copies = (params.duplicateProbability > 0 && chance(random) < params.duplicateProbability) ? 2 : 1;
+                for(int j = 0; j < copies; ++j)
+                {
+                    if(j > 0)
+                        Generate(*data,increment,n,zero); // buffer was swapped
+                    trace::Stamp(trace::PointRead,increment);
+                    SendData();
+                }
+
+                ++increment; // wraps around
+            }
+        }
+
+        Log("HidDevReader::ReadDataSynthetic: Stopped.",LogLevelDebug);
+    }
+}
@@ -0,0 +1,161 @@
+#include "hiddev/hiddevrecords.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace kmicki::hiddev
+{
+    namespace kernel
+    {
+        void ExtractRecordBytesScalar(char const* records, char* out, size_t count)
+        {
+            for (size_t i = 0, j = cRecordBytePos; i < count; ++i,j+=cRecordLen) 
+                out[i] = records[j];
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        // 16 records (128 bytes) -> 16 bytes:
+        // data bytes are lowest bytes of odd 32-bit words of the records.
+        // Pick odd words of 2 vectors at once, mask the data bytes and pack words down to bytes.
+        __attribute__((target("sse2")))
+        void ExtractRecordBytesSse2(char const* records, char* out, size_t count)
+        {
+            static_assert(cRecordLen == 8 && cRecordBytePos == 4,"Kernel assumes data byte at offset 4 of 8-byte record.");
+
+            auto const mask = _mm_set1_epi32(0xFF);
+            size_t i = 0;
+            for(; i+16 <= count; i += 16, records += 16*cRecordLen)
+            {
+                auto src = reinterpret_cast<__m128 const*>(records);
+                auto r0 = _mm_loadu_ps(reinterpret_cast<float const*>(src+0));
+                auto r1 = _mm_loadu_ps(reinterpret_cast<float const*>(src+1));
+                auto r2 = _mm_loadu_ps(reinterpret_cast<float const*>(src+2));
+                auto r3 = _mm_loadu_ps(reinterpret_cast<float const*>(src+3));
+                auto r4 = _mm_loadu_ps(reinterpret_cast<float const*>(src+4));
+                auto r5 = _mm_loadu_ps(reinterpret_cast<float const*>(src+5));
+                auto r6 = _mm_loadu_ps(reinterpret_cast<float const*>(src+6));
+                auto r7 = _mm_loadu_ps(reinterpret_cast<float const*>(src+7));
+
+                auto w0 = _mm_and_si128(_mm_castps_si128(_mm_shuffle_ps(r0,r1,_MM_SHUFFLE(3,1,3,1))),mask);
+                auto w1 = _mm_and_si128(_mm_castps_si128(_mm_shuffle_ps(r2,r3,_MM_SHUFFLE(3,1,3,1))),mask);
+                auto w2 = _mm_and_si128(_mm_castps_si128(_mm_shuffle_ps(r4,r5,_MM_SHUFFLE(3,1,3,1))),mask);
+                auto w3 = _mm_and_si128(_mm_castps_si128(_mm_shuffle_ps(r6,r7,_MM_SHUFFLE(3,1,3,1))),mask);
+
+                auto bytes = _mm_packus_epi16(_mm_packs_epi32(w0,w1),_mm_packs_epi32(w2,w3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),bytes);
+            }
+            ExtractRecordBytesScalar(records,out+i,count-i);
+        }
+
+        // 16 records (128 bytes) -> 16 bytes:
+        // every 256-bit load holds 4 records, 2 per 128-bit lane.
+        // Shuffle data bytes of each load into its own 16-bit slot of the lanes, merge the loads,
+        // then interleave 16-bit slots of both lanes to restore order.
+        __attribute__((target("avx2")))
+        void ExtractRecordBytesAvx2(char const* records, char* out, size_t count)
+        {
+            static_assert(cRecordLen == 8 && cRecordBytePos == 4,"Kernel assumes data byte at offset 4 of 8-byte record.");
+
+            auto const z = (char)0x80;
+            auto const shuffle0 = _mm256_setr_epi8(4,12,z,z,z,z,z,z,z,z,z,z,z,z,z,z, 4,12,z,z,z,z,z,z,z,z,z,z,z,z,z,z);
+            auto const shuffle1 = _mm256_setr_epi8(z,z,4,12,z,z,z,z,z,z,z,z,z,z,z,z, z,z,4,12,z,z,z,z,z,z,z,z,z,z,z,z);
+            auto const shuffle2 = _mm256_setr_epi8(z,z,z,z,4,12,z,z,z,z,z,z,z,z,z,z, z,z,z,z,4,12,z,z,z,z,z,z,z,z,z,z);
+            auto const shuffle3 = _mm256_setr_epi8(z,z,z,z,z,z,4,12,z,z,z,z,z,z,z,z, z,z,z,z,z,z,4,12,z,z,z,z,z,z,z,z);
+
+            size_t i = 0;
+            for(; i+16 <= count; i += 16, records += 16*cRecordLen)
+            {
+                auto src = reinterpret_cast<__m256i const*>(records);
+                auto v0 = _mm256_shuffle_epi8(_mm256_loadu_si256(src+0),shuffle0);
+                auto v1 = _mm256_shuffle_epi8(_mm256_loadu_si256(src+1),shuffle1);
+                auto v2 = _mm256_shuffle_epi8(_mm256_loadu_si256(src+2),shuffle2);
+                auto v3 = _mm256_shuffle_epi8(_mm256_loadu_si256(src+3),shuffle3);
+
+                // lane 0: records 0,1,4,5,8,9,12,13 lane 1: records 2,3,6,7,10,11,14,15
+                auto merged = _mm256_or_si256(_mm256_or_si256(v0,v1),_mm256_or_si256(v2,v3));
+                auto bytes = _mm_unpacklo_epi16(_mm256_castsi256_si128(merged),_mm256_extracti128_si256(merged,1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),bytes);
+            }
+            ExtractRecordBytesScalar(records,out+i,count-i);
+        }
+
+        bool IsAvx2Supported()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        }
+#endif
+    }
+
+    typedef void (*ExtractRecordBytesFn)(char const*, char*, size_t);
+
+    struct RecordKernel
+    {
+        ExtractRecordBytesFn extract;
+        char const* name;
+    };
+
+    static RecordKernel SelectRecordKernel()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if(kernel::IsAvx2Supported())
+            return { kernel::ExtractRecordBytesAvx2, "avx2" };
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("sse2"))
+            return { kernel::ExtractRecordBytesSse2, "sse2" };
+#endif
+        return { kernel::ExtractRecordBytesScalar, "scalar" };
+    }
+
+    static RecordKernel const& GetRecordKernel()
+    {
+        static const RecordKernel recordKernel = SelectRecordKernel();
+        return recordKernel;
+    }
+
+    void ExtractRecordBytes(char const* records, char* out, size_t count)
+    {
+        GetRecordKernel().extract(records,out,count);
+    }
+
+    bool RecordBytesEqual(char const* records, char const* bytes, size_t count)
+    {
+        static const size_t cChunk = 64;
+        char extracted[cChunk];
+
+        while(count > 0)
+        {
+            auto len = (count < cChunk) ? count : cChunk;
+            ExtractRecordBytes(records,extracted,len);
+            if(memcmp(extracted,bytes,len) != 0)
+                return false;
+            records += len*cRecordLen;
+            bytes += len;
+            count -= len;
+        }
+        return true;
+    }
+
+    char const* GetRecordKernelName()
+    {
+        return GetRecordKernel().name;
+    }
+
+    bool IsRecordsFrameStart(char const* records, char const* startMarker, size_t markerLen)
+    {
+        static const uint32_t cFrameStartUsage = 0xFFFF0002;
+        static const uint32_t cFrameStartUsageAlternative = 0xFFFF0001;
+
+        uint32_t usage;
+        memcpy(&usage,records,sizeof(usage));
+        if(usage == cFrameStartUsage)
+            return true;
+        // Check special start marker
+        return usage == cFrameStartUsageAlternative && markerLen > 0
+            && RecordBytesEqual(records,startMarker,markerLen);
+    }
+}
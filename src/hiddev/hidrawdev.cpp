@@ -0,0 +1,100 @@
+#include "hiddev/hidrawdev.h"
+#include "hiddev/hiddevfinder.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace kmicki::hiddev
+{
+    static const std::string cHidrawPath = "/dev/hidraw";
+
+    HidRawDev::HidRawDev(const uint16_t& _vId, const uint16_t _pId, const int& _interfaceNumber)
+        : vId(_vId),pId(_pId),interfaceNumber(_interfaceNumber),fixedPath(false),file(-1),path()
+    { }
+
+    HidRawDev::HidRawDev(std::string const& _path)
+        : vId(0),pId(0),interfaceNumber(-1),fixedPath(true),file(-1),path(_path)
+    { }
+
+    HidRawDev::~HidRawDev()
+    {
+        Close();
+    }
+
+    bool HidRawDev::Open()
+    {
+        if(file >= 0)
+            Close();
+
+        if(!fixedPath)
+        {
+            int hidrawNo = FindHidRawNo(vId,pId,interfaceNumber);
+            if(hidrawNo < 0)
+                return false;
+
+            path = cHidrawPath + std::to_string(hidrawNo);
+        }
+        file = open(path.c_str(),O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        return file >= 0;
+    }
+
+    bool HidRawDev::Close()
+    {
+        if(file < 0)
+            return true;
+        auto result = close(file);
+        file = -1;
+        return result == 0;
+    }
+
+    bool HidRawDev::IsOpen()
+    {
+        return file >= 0;
+    }
+
+    int HidRawDev::GetFd()
+    {
+        return file;
+    }
+
+    std::string const& HidRawDev::GetPath()
+    {
+        return path;
+    }
+
+    int HidRawDev::Read(std::vector<char> & data)
+    {
+        if(file < 0)
+            return -1;
+
+        // hidraw returns exactly one report per read
+        auto readCnt = read(file,data.data(),data.size());
+        if(readCnt < 0)
+            return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        if(readCnt == 0)
+            return -1;
+        return readCnt;
+    }
+
+    bool HidRawDev::Write(std::vector<unsigned char> const& data)
+    {
+        if(file < 0)
+            return false;
+
+        // first byte is report number (0 if device doesn't use numbered reports)
+        auto writeCnt = write(file,data.data(),data.size());
+
+        return writeCnt == data.size();
+    }
+
+    bool HidRawDev::EnableGyro()
+    {
+        static const std::vector<unsigned char> cmd = {   0x00
+                                    , 0x87, 0x0f, 0x30, 0x18, 0x00, 0x07, 0x07, 0x00, 0x08, 0x07, 0x00, 0x31, 0x02, 0x00, 0x18, 0x00
+                                    , 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+                                    , 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+                                    , 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+        return Write(cmd);
+    }
+}
@@ -1,16 +1,300 @@
 #include "log/log.h"
-#include <iostream>
+#include "pipeline/futex.h"
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <exception>
+#include <vector>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <syslog.h>
+#include <systemd/sd-journal.h>
+
+using namespace kmicki::pipeline;
 
 namespace kmicki::log
 {
     LogLevel currentLogType = LogLevelDefault;
 
+    static const int cRecordTextLen = 244;
+    static const uint32_t cRingSize = 256;          // records in queue of a thread (power of 2)
+    static const uint32_t cMaxMessageRecords = 16;  // longer messages are truncated
+
+    // Part of a message. Message longer than a record continues in following records.
+    struct LogRecord
+    {
+        uint32_t sequence;      // order of the message among all threads
+        uint8_t level;
+        bool more;              // message continues in next record
+        uint16_t len;
+        char text[cRecordTextLen];
+    };
+
+    // Queue of messages of a single thread (single producer, single consumer).
+    struct LogRing
+    {
+        LogRecord records[cRingSize];
+        std::atomic<uint32_t> head { 0 };       // next record to be written by the thread
+        std::atomic<uint32_t> tail { 0 };       // next record to be read by writer
+        std::atomic<bool> orphaned { false };   // thread has exited
+    };
+
+    // Background thread that writes queued messages.
+    class LogWriter
+    {
+        public:
+        LogWriter();
+        ~LogWriter();
+
+        void Register(std::shared_ptr<LogRing> const& ring);
+
+        // New message was queued.
+        void Notify();
+
+        void Flush();
+
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint64_t> dropped;
+
+        private:
+        struct Message
+        {
+            uint32_t sequence;
+            uint8_t level;
+            std::string text;
+        };
+
+        std::mutex ringsMutex;
+        std::vector<std::shared_ptr<LogRing>> rings;
+
+        std::atomic<uint32_t> pending;      // increased for every queued message (futex word)
+        std::atomic<uint32_t> drained;      // value of pending of which all messages were written
+        std::atomic<bool> sleeping;
+        std::atomic<bool> stop;
+        bool journal;
+        uint64_t reportedDropped;
+
+        std::vector<Message> messages;
+        std::string out;
+
+        std::thread thread;
+
+        void writerTask();
+
+        // Write all queued messages. Returns false if there were none.
+        bool Drain();
+        void Write(uint8_t const& level, std::string const& text);
+    };
+
+    static std::atomic<bool> writerClosed(false);
+    static std::terminate_handler previousTerminate = nullptr;
+
+    // Messages queued before an unhandled exception still get written.
+    static void FlushOnTerminate()
+    {
+        FlushLog();
+        if(previousTerminate != nullptr)
+            previousTerminate();
+        std::abort();
+    }
+
+    static LogWriter & GetWriter()
+    {
+        static LogWriter writer;
+        return writer;
+    }
+
+    // Queue of the calling thread, registered with the writer on first use.
+    // Writer keeps the queue after the thread exits, until it's empty.
+    struct LogRingHolder
+    {
+        std::shared_ptr<LogRing> ring;
+
+        LogRingHolder() : ring(new LogRing())
+        {
+            GetWriter().Register(ring);
+        }
+
+        ~LogRingHolder()
+        {
+            ring->orphaned = true;
+        }
+    };
+
+    static LogRing & GetThreadRing()
+    {
+        thread_local LogRingHolder holder;
+        return *holder.ring;
+    }
+
+    LogWriter::LogWriter()
+        : sequence(0), dropped(0), pending(0), drained(0), sleeping(false), stop(false),
+          journal(std::getenv("SDGYRO_LOG_JOURNAL") != nullptr), reportedDropped(0)
+    {
+        // Writer thread is started with all signals blocked (it inherits the mask),
+        // so that signals are never delivered to it: they have to reach the signal handler
+        // or signalfd of the main thread, and a handler that logs must not interrupt a drain.
+        sigset_t all, previous;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK,&all,&previous);
+        thread = std::thread(&LogWriter::writerTask,this);
+        pthread_sigmask(SIG_SETMASK,&previous,nullptr);
+        previousTerminate = std::set_terminate(FlushOnTerminate);
+    }
+
+    LogWriter::~LogWriter()
+    {
+        stop = true;
+        pending.fetch_add(1);
+        FutexWakeAll(pending);
+        thread.join();
+        writerClosed = true;
+    }
+
+    void LogWriter::Register(std::shared_ptr<LogRing> const& ring)
+    {
+        std::lock_guard lock(ringsMutex);
+        rings.push_back(ring);
+    }
+
+    void LogWriter::Notify()
+    {
+        pending.fetch_add(1);
+        // only the first message wakes the writer, following ones are written together with it
+        if(sleeping.exchange(false))
+            FutexWake(pending);
+    }
+
+    void LogWriter::Flush()
+    {
+        auto target = pending.load();
+        while((int32_t)(drained.load() - target) < 0 && !writerClosed)
+        {
+            FutexWake(pending);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void LogWriter::writerTask()
+    {
+        static const auto cIdleTimeout = std::chrono::seconds(1);
+        static const auto cBatchDelay = std::chrono::milliseconds(2);
+
+        pthread_setname_np(pthread_self(),"sdgyro-log");
+
+        while(!stop)
+        {
+            auto seen = pending.load();
+            if(!Drain())
+            {
+                drained = seen;
+                sleeping = true;
+                if(!stop)
+                    FutexWait(pending,seen,cIdleTimeout);
+                sleeping = false;
+                // let messages accumulate to write them at once
+                if(!stop)
+                    std::this_thread::sleep_for(cBatchDelay);
+            }
+            else
+                drained = seen;
+        }
+        Drain();
+    }
+
+    bool LogWriter::Drain()
+    {
+        messages.clear();
+        {
+            std::lock_guard lock(ringsMutex);
+            for(auto ring = rings.begin(); ring != rings.end();)
+            {
+                auto & r = **ring;
+                auto head = r.head.load(std::memory_order_acquire);
+                auto tail = r.tail.load(std::memory_order_relaxed);
+                if(head == tail && r.orphaned)
+                {
+                    ring = rings.erase(ring);
+                    continue;
+                }
+                while(tail != head)
+                {
+                    auto const& first = r.records[tail % cRingSize];
+                    auto & message = messages.emplace_back();
+                    message.sequence = first.sequence;
+                    message.level = first.level;
+                    bool more = true;
+                    while(more)
+                    {
+                        auto const& record = r.records[tail % cRingSize];
+                        message.text.append(record.text,record.len);
+                        more = record.more;
+                        ++tail;
+                    }
+                }
+                r.tail.store(tail,std::memory_order_release);
+                ++ring;
+            }
+        }
+
+        auto dropCount = dropped.load();
+        if(messages.empty() && dropCount == reportedDropped)
+            return false;
+
+        // messages of different threads in order they were logged
+        std::sort(messages.begin(),messages.end(),[](Message const& a, Message const& b)
+        {
+            return (int32_t)(a.sequence - b.sequence) < 0;
+        });
+
+        for(auto const& message : messages)
+            Write(message.level,message.text);
+
+        if(dropCount != reportedDropped)
+        {
+            Write(LogLevelDefault,"Log: " + std::to_string(dropCount - reportedDropped) + " messages dropped (queue full).");
+            reportedDropped = dropCount;
+        }
+
+        // stdout: all messages at once
+        auto data = out.data();
+        auto left = out.size();
+        while(left > 0)
+        {
+            auto written = write(STDOUT_FILENO,data,left);
+            if(written <= 0)
+                break;
+            data += written;
+            left -= written;
+        }
+        out.clear();
+
+        return true;
+    }
+
+    void LogWriter::Write(uint8_t const& level, std::string const& text)
+    {
+        if(journal)
+            sd_journal_print(level <= LogLevelDefault ? LOG_INFO : LOG_DEBUG,"%s",text.c_str());
+        else
+        {
+            out.append(text);
+            out.push_back('\n');
+        }
+    }
+
     void SetLogLevel(LogLevel type)
     {
         currentLogType = type;
     }
-    
+
     LogLevel const& GetLogLevel()
     {
         return currentLogType;
@@ -21,24 +305,77 @@ namespace kmicki::log
         if(type > currentLogType)
             return;
 
-        static std::mutex logMutex;
-        std::lock_guard lock(logMutex);
-        std::cout << message << std::endl;
+        if(writerClosed)
+        {
+            // during exit, after the writer is gone
+            message.push_back('\n');
+            auto written = write(STDOUT_FILENO,message.data(),message.size());
+            (void)written;
+            return;
+        }
+
+        auto & writer = GetWriter();
+        auto & ring = GetThreadRing();
+
+        uint32_t count = std::max<size_t>(1,(message.size() + cRecordTextLen - 1) / cRecordTextLen);
+        count = std::min(count,cMaxMessageRecords);
+
+        auto head = ring.head.load(std::memory_order_relaxed);
+        auto tail = ring.tail.load(std::memory_order_acquire);
+        if(cRingSize - (head - tail) < count)
+        {
+            writer.dropped.fetch_add(1);
+            writer.Notify();
+            return;
+        }
+
+        auto sequence = writer.sequence.fetch_add(1);
+        size_t pos = 0;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            auto & record = ring.records[(head + i) % cRingSize];
+            auto len = std::min<size_t>(message.size() - pos,cRecordTextLen);
+            record.sequence = sequence;
+            record.level = type;
+            record.more = i + 1 < count;
+            record.len = len;
+            memcpy(record.text,message.data() + pos,len);
+            pos += len;
+        }
+        ring.head.store(head + count,std::memory_order_release);
+
+        writer.Notify();
+    }
+
+    void FlushLog()
+    {
+        if(!writerClosed)
+            GetWriter().Flush();
+    }
+
+    uint64_t GetDroppedLogCount()
+    {
+        return GetWriter().dropped.load();
     }
 
     LogF::LogF(LogLevel type)
-    : std::ostringstream(), logType(type)
-    {};
+    : logType(type)
+    {
+        if(IsLogged(type))
+            stream.emplace();
+    };
 
     LogF::~LogF()
     {
-        Log(str(),logType);
+        if(stream)
+            Log(stream->str(),logType);
     }
 
     void LogF::LogNow()
     {
-        Log(str(),logType);
-        std::ostringstream newStream;
-        swap(newStream);
+        if(!stream)
+            return;
+        Log(stream->str(),logType);
+        stream.emplace();
     }
-}
\ No newline at end of file
+}
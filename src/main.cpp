@@ -5,17 +5,30 @@
 #include "cemuhook/cemuhookprotocol.h"
 #include "cemuhook/cemuhookserver.h"
 #include "sdgyrodsu/cemuhookadapter.h"
+#include "sdgyrodsu/reactor.h"
+#include "sdgyrodsu/shmpublisher.h"
+#include "sdgyrodsu/metricsserver.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
 #include <iostream>
 #include <future>
 #include <thread>
 #include <csignal>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
 
 using namespace kmicki::sdgyrodsu;
 using namespace kmicki::hiddev;
 using namespace kmicki::log;
 using namespace kmicki::cemuhook::protocol;
 using namespace kmicki::cemuhook;
+using kmicki::pipeline::RealtimeProfile;
 
 const LogLevel cLogLevel = LogLevelDebug; // change to Default when configuration is possible
 const bool cRunPresenter = false;
@@ -30,42 +43,185 @@ const int cInterfaceNumber = 2; // Steam Deck Controls' USB Interface Number
 
 const std::string cVersion = "2.1";   // Release version
 
-bool stop = false;
-std::mutex stopMutex = std::mutex();
-std::condition_variable stopCV = std::condition_variable();
+// Real-time profile (enabled by SDGYRO_REALTIME environment variable)
+const int cRtPriorityRead = 60;             // SCHED_FIFO priority of HID reading thread
+const int cRtPriorityProcess = 59;          // SCHED_FIFO priority of frame processing thread
+const int cRtPriorityServe = 58;            // SCHED_FIFO priority of frame serving thread
+const int cRtPrioritySend = 57;             // SCHED_FIFO priority of DSU sending thread
+const unsigned long cRtTimerSlackNs = 1000; // timer slack of real-time threads
+const size_t cRtPrefaultStack = 128*1024;   // stack prefaulted and locked in real-time threads
 
-void SignalHandler(int signal)
+const int cStatsPeriodSec = 60;             // default period of statistics summary in the log
+const auto cStatsTickPeriod = std::chrono::seconds(1);
+
+// Signals handled by the main loop.
+// They are blocked in all threads and taken by the main loop with sigtimedwait,
+// so they never interrupt a thread (e.g. in the middle of logging).
+sigset_t GetHandledSignals()
 {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals,SIGINT);
+    sigaddset(&signals,SIGTERM);
+    sigaddset(&signals,SIGUSR1);
+    return signals;
+}
+
+// Returns true if the signal stops the server.
+bool HandleSignal(int signal)
+{
+    LogF msg;
+    msg << "Incoming signal: ";
+    switch(signal)
     {
-        LogF msg;
-        msg << "Incoming signal: ";
-        bool stopCmd = true;
-        switch(signal)
-        {
-            case SIGINT:
-                msg << "SIGINT";
-                break;
-            case SIGTERM:
-                msg << "SIGTERM";
-                break;
-            default:
-                msg << "Other";
-                stopCmd = false;
-                break;
-        }
-        if(!stopCmd)
+        case SIGINT:
+            msg << "SIGINT. Stopping...";
+            return true;
+        case SIGTERM:
+            msg << "SIGTERM. Stopping...";
+            return true;
+        case SIGUSR1:
+            msg << "SIGUSR1. Dumping statistics and latency trace...";
+            return false;
+        default:
+            msg << "Other. Unhandled, ignoring...";
+            return false;
+    }
+}
+
+// Read comma-separated list of CPUs from SDGYRO_REALTIME_CPUS environment variable.
+std::vector<int> GetRealtimeCpus()
+{
+    std::vector<int> cpus;
+    char const* env = std::getenv("SDGYRO_REALTIME_CPUS");
+    if(env == nullptr)
+        return cpus;
+    std::istringstream list(env);
+    std::string item;
+    while(std::getline(list,item,','))
+    {
+        char * end;
+        long cpu = std::strtol(item.c_str(),&end,10);
+        if(end != item.c_str() && cpu >= 0)
+            cpus.push_back((int)cpu);
+    }
+    return cpus;
+}
+
+// Controller device assigned to a DSU slot.
+struct SlotDevice
+{
+    uint16_t vId;
+    uint16_t pId;
+    int interfaceNumber;
+};
+
+// Devices of DSU slots from SDGYRO_SLOTS environment variable:
+// comma-separated list of VID:PID:interface (IDs hexadecimal), one per slot starting from slot 0.
+// Only Steam Deck Controls in slot 0 if unset.
+std::vector<SlotDevice> GetSlotDevices()
+{
+    std::vector<SlotDevice> devices;
+    if(char const* env = std::getenv("SDGYRO_SLOTS"))
+    {
+        std::istringstream list(env);
+        std::string item;
+        while(std::getline(list,item,','))
         {
-            msg << ". Unhandled, ignoring...";
-            return;
+            if(devices.size() >= Server::cSlotCount)
+            {
+                { LogF() << "Only " << Server::cSlotCount << " slots available. Ignoring device " << item << "."; }
+                continue;
+            }
+            unsigned vId, pId;
+            int interfaceNumber;
+            if(std::sscanf(item.c_str(),"%x:%x:%d",&vId,&pId,&interfaceNumber) == 3)
+                devices.push_back({(uint16_t)vId,(uint16_t)pId,interfaceNumber});
+            else
+                { LogF() << "Invalid slot device: " << item << ". Expected VID:PID:interface."; }
         }
-        msg << ". Stopping...";
     }
+    if(devices.empty())
+        devices.push_back({cVID,cPID,cInterfaceNumber});
+    return devices;
+}
 
+// Replay period from SDGYRO_REPLAY_RATE environment variable:
+// rate in Hz, "max" (as fast as possible) or unset (original timing).
+int GetReplayPeriodUs()
+{
+    char const* env = std::getenv("SDGYRO_REPLAY_RATE");
+    if(env == nullptr)
+        return HidDevReader::cReplayOriginalTiming;
+    if(std::string(env) == "max")
+        return 0;
+    auto rate = std::atof(env);
+    if(rate <= 0)
+        return HidDevReader::cReplayOriginalTiming;
+    return (int)(1000000/rate);
+}
+
+// Period of statistics summary from SDGYRO_STATS_PERIOD environment variable:
+// seconds, 0 disables periodic summary (totals are still logged on exit).
+std::chrono::seconds GetStatsPeriod()
+{
+    char const* env = std::getenv("SDGYRO_STATS_PERIOD");
+    if(env == nullptr)
+        return std::chrono::seconds(cStatsPeriodSec);
+    return std::chrono::seconds(std::max(0,std::atoi(env)));
+}
+
+// Parameters of synthetic frames from SDGYRO_SYNTHETIC environment variable:
+// comma-separated list of name=value (names as in HidDevReader::SyntheticParams, e.g. "rate=2500,gap=0.01").
+HidDevReader::SyntheticParams GetSyntheticParams(char const* env)
+{
+    HidDevReader::SyntheticParams params;
+    std::istringstream list(env);
+    std::string item;
+    while(std::getline(list,item,','))
     {
-        std::lock_guard lock(stopMutex);
-        stop = true;
+        auto eq = item.find('=');
+        if(eq == std::string::npos)
+            continue;
+        auto name = item.substr(0,eq);
+        auto value = item.substr(eq+1);
+        if(name == "rate")
+            params.rate = std::atof(value.c_str());
+        else if(name == "start")
+            params.startIncrement = (uint32_t)std::strtoul(value.c_str(),nullptr,0);
+        else if(name == "gap")
+            params.gapProbability = std::atof(value.c_str());
+        else if(name == "maxgap")
+            params.maxGap = std::atoi(value.c_str());
+        else if(name == "dup")
+            params.duplicateProbability = std::atof(value.c_str());
+        else if(name == "zero")
+            params.zeroProbability = std::atof(value.c_str());
+        else if(name == "burst")
+            params.burst = std::atoi(value.c_str());
+        else if(name == "jitter")
+            params.jitterUs = std::atoi(value.c_str());
+        else if(name == "seed")
+            params.seed = (uint32_t)std::strtoul(value.c_str(),nullptr,0);
+        else
+            { LogF() << "Unknown synthetic frames parameter: " << name << "."; }
     }
-    stopCV.notify_all();
+    if(params.rate <= 0)
+        params.rate = 1000000.0/cScanTimeUs;
+    if(params.jitterUs < 0)
+        params.jitterUs = 0;
+    return params;
+}
+
+RealtimeProfile GetRealtimeProfile(int priority, std::vector<int> const& cpus)
+{
+    RealtimeProfile profile;
+    profile.policy = SCHED_FIFO;
+    profile.priority = priority;
+    profile.cpus = cpus;
+    profile.timerSlackNs = cRtTimerSlackNs;
+    profile.prefaultStackBytes = cRtPrefaultStack;
+    return profile;
 }
 
 void PresenterRun(HidDevReader * reader)
@@ -78,18 +234,46 @@ void PresenterRun(HidDevReader * reader)
     Presenter::Initialize();
     while(true)
     {
-        auto lock = frameServe.GetConsumeLock();
+        frameServe.WaitForData();
         Presenter::Present(GetSdFrame(*data));
     }
     Presenter::Finish();
 }
 
-int main()
+// Run whole server in a single thread (SDGYRO_REACTOR environment variable).
+int RunReactor()
 {
-    signal(SIGINT,SignalHandler);
-    signal(SIGTERM,SignalHandler);
+    Log("Running in single-threaded mode.");
 
-    stop = false;
+    if(std::getenv("SDGYRO_SHM"))
+        Log("Shared memory publishing is not available in single-threaded mode.");
+    if(std::getenv("SDGYRO_METRICS"))
+        Log("Metrics endpoint is not available in single-threaded mode.");
+
+    if(std::getenv("SDGYRO_REALTIME"))
+    {
+        kmicki::pipeline::LockMemory();
+        kmicki::pipeline::ApplyRealtimeProfile("sdgyro-reactor",GetRealtimeProfile(cRtPriorityRead,GetRealtimeCpus()));
+    }
+
+    {
+        Reactor reactor(cVID,cPID,cInterfaceNumber,cFrameLen,{ 0x01, 0x00, 0x09, 0x40 },std::getenv("SDGYRO_IO_URING") != nullptr);
+        reactor.Run();
+    }
+
+    kmicki::stats::LogTotals();
+    kmicki::trace::Dump();
+
+    Log("SteamDeckGyroDSU exiting.");
+
+    return 0;
+}
+
+int main()
+{
+    // before any thread is created, so that all of them inherit the mask
+    auto handledSignals = GetHandledSignals();
+    pthread_sigmask(SIG_BLOCK,&handledSignals,nullptr);
 
     if(cRunPresenter)
         SetLogLevel(LogLevelNone);
@@ -98,9 +282,26 @@ int main()
 
     { LogF() << "SteamDeckGyroDSU Version: " << cVersion; }
 
-    std::unique_ptr<HidDevReader> readerPtr;
+    if(std::getenv("SDGYRO_TRACE"))
+        kmicki::trace::Enable();
+
+    kmicki::stats::SetSummaryPeriod(GetStatsPeriod());
+
+    if(!cRunPresenter && std::getenv("SDGYRO_REACTOR"))
+        return RunReactor();
+
+    // One reader per slot
+    std::vector<std::unique_ptr<HidDevReader>> readers;
 
-    if(cUseHiddevFile)
+    if(char const* replayPath = std::getenv("SDGYRO_REPLAY"))
+    {
+        readers.emplace_back(new HidDevReader(replayPath,GetReplayPeriodUs(),cScanTimeUs));
+    }
+    else if(char const* synthetic = std::getenv("SDGYRO_SYNTHETIC"))
+    {
+        readers.emplace_back(new HidDevReader(GetSyntheticParams(synthetic),cFrameLen));
+    }
+    else if(cUseHiddevFile)
     {
         int hidno = FindHidDevNo(cVID,cPID);
         if(hidno < 0) 
@@ -111,36 +312,110 @@ int main()
 
         { LogF() << "Found Steam Deck Controls' HID device at /dev/usb/hiddev" << hidno; }
         
-        readerPtr.reset(new HidDevReader(hidno,cFrameLen,cScanTimeUs));
+        readers.emplace_back(new HidDevReader(hidno,cFrameLen,cScanTimeUs));
     }
     else
     {
-        readerPtr.reset(new HidDevReader(cVID,cPID,cInterfaceNumber,cFrameLen,cScanTimeUs));
+        bool useHidApi = std::getenv("SDGYRO_HIDAPI") != nullptr;
+        for(auto const& device : GetSlotDevices())
+        {
+            { LogF() << "Slot " << readers.size() << ": device " << std::hex << std::setfill('0')
+                     << std::setw(4) << device.vId << ":" << std::setw(4) << device.pId 
+                     << std::dec << " interface " << device.interfaceNumber << "."; }
+            readers.emplace_back(new HidDevReader(device.vId,device.pId,device.interfaceNumber,cFrameLen,cScanTimeUs,useHidApi));
+        }
     }
 
-    HidDevReader &reader = *readerPtr;
+    for(int i = 0; i < readers.size(); ++i)
+    {
+        auto & reader = *readers[i];
 
-    reader.SetStartMarker({ 0x01, 0x00, 0x09, 0x40 }); // Beginning of every Steam Decks' HID frame
+        reader.SetStartMarker({ 0x01, 0x00, 0x09, 0x40 }); // Beginning of every Steam Decks' HID frame
 
-    CemuhookAdapter adapter(reader);
-    reader.SetNoGyro(adapter.NoGyro);
-    Server server(adapter);
+        if(char const* captureEnv = std::getenv("SDGYRO_CAPTURE"))
+        {
+            // slots other than 0 are captured into files with slot number appended
+            std::string capturePath(captureEnv);
+            if(i > 0)
+                capturePath += "." + std::to_string(i);
+            if(!reader.SetCapture(capturePath))
+                { LogF() << "Capture file " << capturePath << " could not be created."; }
+        }
+    }
+
+    RealtimeProfile receiveProfile, sendProfile;
+
+    if(std::getenv("SDGYRO_REALTIME"))
+    {
+        Log("Real-time profile requested.");
+        kmicki::pipeline::LockMemory();
+        auto cpus = GetRealtimeCpus();
+        for(auto & reader : readers)
+            reader->SetRealtimeProfile(GetRealtimeProfile(cRtPriorityRead,cpus),
+                                       GetRealtimeProfile(cRtPriorityProcess,cpus),
+                                       GetRealtimeProfile(cRtPriorityServe,cpus));
+        sendProfile = GetRealtimeProfile(cRtPrioritySend,cpus);
+        // receiving thread only answers client requests: keep default scheduling
+        receiveProfile.timerSlackNs = cRtTimerSlackNs;
+    }
+
+    std::vector<std::unique_ptr<CemuhookAdapter>> adapters;
+    std::vector<CemuhookAdapter*> slotSources;
+    for(auto & reader : readers)
+    {
+        adapters.emplace_back(new CemuhookAdapter(*reader));
+        reader->SetNoGyro(adapters.back()->NoGyro);
+        slotSources.push_back(adapters.back().get());
+    }
+    Server server(slotSources,receiveProfile,sendProfile);
+
+    std::unique_ptr<ShmPublisher> shmPublisher;
+    if(std::getenv("SDGYRO_SHM"))
+    {
+        std::vector<HidDevReader*> slotReaders;
+        std::vector<SignalOut*> slotNoGyro;
+        for(int i = 0; i < readers.size(); ++i)
+        {
+            slotReaders.push_back(readers[i].get());
+            slotNoGyro.push_back(&adapters[i]->NoGyro);
+        }
+        shmPublisher.reset(new ShmPublisher(slotReaders,slotNoGyro,sendProfile));
+    }
+
+    std::unique_ptr<MetricsServer> metricsServer;
+    if(char const* metricsAddress = std::getenv("SDGYRO_METRICS"))
+        metricsServer.reset(new MetricsServer(metricsAddress,server));
 
     uint32_t lastInc = 0;
     int stopping = 0;
 
     std::unique_ptr<std::thread> presenter;
     if(cRunPresenter)
-        presenter.reset(new std::thread(PresenterRun,&reader));
+        presenter.reset(new std::thread(PresenterRun,readers.front().get()));
 
     if(cTestRun && !cRunPresenter)
-        reader.Start();
+        readers.front()->Start();
 
+    auto tick = std::chrono::duration_cast<std::chrono::seconds>(cStatsTickPeriod).count();
+    while(true)
     {
-        std::unique_lock lock(stopMutex);
-        stopCV.wait(lock,[]{ return stop; });
+        timespec timeout = { tick, 0 };
+        int signal = sigtimedwait(&handledSignals,nullptr,&timeout);
+        if(signal < 0)
+        {
+            if(errno == EAGAIN)
+                kmicki::stats::Tick();
+            continue;
+        }
+        if(HandleSignal(signal))
+            break;
+        kmicki::stats::LogSummary();
+        kmicki::trace::Dump();
     }
 
+    kmicki::stats::LogTotals();
+    kmicki::trace::Dump();
+
     Log("SteamDeckGyroDSU exiting.");
 
     return 0;
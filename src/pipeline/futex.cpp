@@ -0,0 +1,52 @@
+#include "pipeline/futex.h"
+
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace kmicki::pipeline
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Futex word has to be plain 32-bit integer.");
+
+    static long Futex(std::atomic<uint32_t> & word, int op, uint32_t val, timespec const* timeout)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, val, timeout, nullptr, 0);
+    }
+
+    bool FutexWait(std::atomic<uint32_t> & word, uint32_t expected)
+    {
+        Futex(word, FUTEX_WAIT_PRIVATE, expected, nullptr);
+        return true;
+    }
+
+    bool FutexWait(std::atomic<uint32_t> & word, uint32_t expected, std::chrono::nanoseconds timeout)
+    {
+        if(timeout.count() <= 0)
+            return word.load() != expected;
+
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+        timespec ts { (time_t)secs.count(), (long)(timeout - secs).count() };
+
+        if(Futex(word, FUTEX_WAIT_PRIVATE, expected, &ts) < 0 && errno == ETIMEDOUT)
+            return false;
+        return true;
+    }
+
+    void FutexWake(std::atomic<uint32_t> & word, int count)
+    {
+        Futex(word, FUTEX_WAKE_PRIVATE, count, nullptr);
+    }
+
+    void FutexWakeAll(std::atomic<uint32_t> & word)
+    {
+        FutexWake(word, INT_MAX);
+    }
+
+    void FutexWakeAllShared(uint32_t * word)
+    {
+        syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
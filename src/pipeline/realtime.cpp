@@ -0,0 +1,127 @@
+#include "pipeline/realtime.h"
+#include "log/log.h"
+
+#include <cstring>
+#include <cerrno>
+#include <alloca.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+using namespace kmicki::log;
+
+namespace kmicki::pipeline
+{
+    bool RealtimeProfile::IsDefault() const
+    {
+        return (policy == SCHED_OTHER || priority <= 0) && cpus.empty() 
+               && timerSlackNs == 0 && prefaultStackBytes == 0;
+    }
+
+    static const char * GetPolicyName(int policy)
+    {
+        switch(policy)
+        {
+            case SCHED_FIFO:
+                return "SCHED_FIFO";
+            case SCHED_RR:
+                return "SCHED_RR";
+            default:
+                return "SCHED_OTHER";
+        }
+    }
+
+    // Touch stack pages, so that they're mapped before they're needed, and lock them.
+    static int PrefaultStack(size_t bytes)
+    {
+        auto stack = static_cast<char*>(alloca(bytes));
+        memset(stack,0,bytes);
+        // keep the writes (stack is freed at return, so they would be dead stores)
+        asm volatile("" : : "r"(stack) : "memory");
+        if(mlock(stack,bytes) != 0)
+            return errno;
+        return 0;
+    }
+
+    bool ApplyRealtimeProfile(std::string const& threadName, RealtimeProfile const& profile)
+    {
+        pthread_setname_np(pthread_self(),threadName.substr(0,15).c_str());
+
+        if(profile.IsDefault())
+            return true;
+
+        bool result = true;
+        LogF msg;
+        msg << "Realtime: " << threadName << ":";
+
+        if(profile.policy != SCHED_OTHER && profile.priority > 0)
+        {
+            sched_param param;
+            param.sched_priority = profile.priority;
+            msg << " " << GetPolicyName(profile.policy) << " priority " << profile.priority;
+            if(auto err = pthread_setschedparam(pthread_self(),profile.policy,&param))
+            {
+                msg << " failed (" << strerror(err) << "), default scheduling kept;";
+                result = false;
+            }
+            else
+                msg << " applied;";
+        }
+
+        if(!profile.cpus.empty())
+        {
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            msg << " CPUs";
+            for(auto cpu : profile.cpus)
+            {
+                CPU_SET(cpu,&cpuSet);
+                msg << " " << cpu;
+            }
+            if(auto err = pthread_setaffinity_np(pthread_self(),sizeof(cpuSet),&cpuSet))
+            {
+                msg << " failed (" << strerror(err) << "), not pinned;";
+                result = false;
+            }
+            else
+                msg << " applied;";
+        }
+
+        if(profile.timerSlackNs > 0)
+        {
+            msg << " timer slack " << profile.timerSlackNs << " ns";
+            if(prctl(PR_SET_TIMERSLACK,profile.timerSlackNs,0,0,0) != 0)
+            {
+                msg << " failed (" << strerror(errno) << ");";
+                result = false;
+            }
+            else
+                msg << " applied;";
+        }
+
+        if(profile.prefaultStackBytes > 0)
+        {
+            msg << " stack " << profile.prefaultStackBytes << " B prefaulted";
+            if(auto err = PrefaultStack(profile.prefaultStackBytes))
+            {
+                msg << ", locking failed (" << strerror(err) << ");";
+                result = false;
+            }
+            else
+                msg << " and locked;";
+        }
+
+        return result;
+    }
+
+    bool LockMemory()
+    {
+        if(mlockall(MCL_CURRENT) != 0)
+        {
+            { LogF() << "Realtime: Locking process memory failed (" << strerror(errno) << "). Memory may be paged out."; }
+            return false;
+        }
+        Log("Realtime: Process memory locked.");
+        return true;
+    }
+}
@@ -1,19 +1,29 @@
 #include "pipeline/thread.h"
 
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
 namespace kmicki::pipeline
 {
     // Definition - Thread
 
-    const std::chrono::milliseconds Thread::cTimeout(100);
+    const uint32_t Thread::cStateStop = 1;
+    const uint32_t Thread::cStateRestart = 2;
 
     Thread::Thread()
-    : executeThread(),stopMutex(),stop(false)
-    {}
+    : executeThread(),state(0),wakeFd(eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC)),
+      name(),realtimeProfile()
+    {
+        if(wakeFd < 0)
+            throw std::runtime_error("Thread: Failed to create wake file descriptor.");
+    }
     
     Thread::~Thread()
     {
         if(executeThread != nullptr)
-            TryStopThenKill();
+            Stop();
+        close(wakeFd);
     }
 
     void Thread::Start()
@@ -21,9 +31,9 @@ namespace kmicki::pipeline
         if(executeThread != nullptr)
             return;
         
-        stop = false;
-        executeThread.reset(new std::thread(&Thread::Execute,this));
-        threadHandle = executeThread->native_handle();
+        state.store(0);
+        ClearWake();
+        executeThread.reset(new std::thread(&Thread::Run,this));
     }
 
     void Thread::Stop()
@@ -31,64 +41,81 @@ namespace kmicki::pipeline
         if(executeThread == nullptr)
             return;
 
-        {
-            std::lock_guard lock(stopMutex);
-            stop = true;
-        }
+        state.fetch_or(cStateStop);
+        Wake();
         FlushPipes();
         executeThread->join();
         executeThread.reset();
-        stop = false;
+        state.store(0);
     }
 
-    void Thread::Kill()
+    void Thread::Restart()
     {
         if(executeThread == nullptr)
+        {
+            Start();
             return;
-        pthread_cancel(threadHandle);
-        executeThread->join();
-        executeThread.reset();
-        stop = false;
+        }
+
+        state.fetch_or(cStateRestart);
+        Wake();
+        FlushPipes();
     }
 
-    void Thread::Restart()
+    bool Thread::IsStarted()
     {
-        Stop();
-        Start();
+        return executeThread != nullptr;
     }
 
-    void Thread::ForceRestart()
+    bool Thread::IsStopping()
     {
-        Kill();
-        Start();
+        if(!IsStarted())
+            return false;
+        return (state.load(std::memory_order_relaxed) & cStateStop) != 0;
     }
 
-    void Thread::TryStopThenKill()
+    bool Thread::ShouldContinue()
     {
-        TryStopThenKill(cTimeout);
+        return state.load(std::memory_order_relaxed) == 0;
     }
 
-    void Thread::TryRestartThenForceRestart()
+    void Thread::SetRealtimeProfile(std::string const& _name, RealtimeProfile const& profile)
     {
-        TryRestartThenForceRestart(cTimeout);
+        name = _name;
+        realtimeProfile = profile;
     }
 
-    bool Thread::IsStarted()
+    int Thread::GetWakeFd()
     {
-        return executeThread != nullptr;
+        return wakeFd;
     }
 
-    bool Thread::IsStopping()
+    void Thread::Run()
     {
-        if(!IsStarted())
-            return false;
-        std::lock_guard lock(stopMutex);
-        return stop;
+        if(!name.empty())
+            ApplyRealtimeProfile(name,realtimeProfile);
+
+        while(true)
+        {
+            Execute();
+
+            if((state.load() & cStateRestart) == 0 || (state.load() & cStateStop) != 0)
+                break;
+
+            // Stop requested after this point is still seen by ShouldContinue()
+            state.fetch_and(~cStateRestart);
+            ClearWake();
+        }
     }
 
-    bool Thread::ShouldContinue()
+    void Thread::Wake()
+    {
+        eventfd_write(wakeFd,1);
+    }
+
+    void Thread::ClearWake()
     {
-        std::lock_guard lock(stopMutex);
-        return !stop;
+        eventfd_t value;
+        eventfd_read(wakeFd,&value);
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include "sdgyrodsu/cemuhookadapter.h"
 #include "sdgyrodsu/sdhidframe.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
 
 #include <iostream>
 #include <iomanip>
@@ -95,11 +97,22 @@ namespace kmicki::sdgyrodsu
         }
     }
 
+    CemuhookAdapter::CemuhookAdapter(bool persistent)
+    : reader(nullptr), frameServe(nullptr), noGyro(&NoGyro),
+      lastInc(0), lastTimestamp(0), periodUs(SD_SCANTIME_US), clock((uint64_t)SD_SCANTIME_US*1000),
+      lastAccelRtL(0.0),lastAccelFtB(0.0),lastAccelTtB(0.0),
+      isPersistent(persistent), toReplicate(0), noGyroCooldown(0),
+      batchSize(0), batchPos(0)
+    {
+        Log("CemuhookAdapter: Initialized without reader.",LogLevelDebug);
+    }
+
     CemuhookAdapter::CemuhookAdapter(hiddev::HidDevReader & _reader, bool persistent)
-    : reader(_reader),
-      lastInc(0),
+    : reader(&_reader), frameServe(nullptr), noGyro(&NoGyro),
+      lastInc(0), lastTimestamp(0), periodUs(SD_SCANTIME_US), clock((uint64_t)SD_SCANTIME_US*1000),
       lastAccelRtL(0.0),lastAccelFtB(0.0),lastAccelTtB(0.0),
-      isPersistent(persistent), toReplicate(0), noGyroCooldown(0)
+      isPersistent(persistent), toReplicate(0), noGyroCooldown(0),
+      batchSize(0), batchPos(0)
     {
         Log("CemuhookAdapter: Initialized. Waiting for start of frame grab.",LogLevelDebug);
     }
@@ -107,26 +120,101 @@ namespace kmicki::sdgyrodsu
     void CemuhookAdapter::StartFrameGrab()
     {
         lastInc = 0;
+        lastTimestamp = 0;
+        clock.Reset();
         ignoreFirst = true;
+        batchSize = batchPos = 0;
         Log("CemuhookAdapter: Starting frame grab.",LogLevelDebug);
-        reader.Start();
-        frameServe = &reader.GetServe();
+        if(reader == nullptr)
+            return;
+        reader->Start();
+        frameServe = &reader->GetServe();
     }
 
-    int const& CemuhookAdapter::SetMotionDataNewFrame(MotionData &motion)
+    bool CemuhookAdapter::UseFrame(SdHidFrame const& frame, uint64_t const& hostTimestamp, MotionData &motion)
     {
         static const int64_t cMaxDiffReplicate = 100;
+        static const int64_t cMaxDiffMissed = 1000;     // larger jump means the counter was reset
         static const int cNoGyroCooldownFrames = 1000;
+
+        if( noGyroCooldown <= 0
+            &&  frame.AccelAxisFrontToBack == 0 && frame.AccelAxisRightToLeft == 0 
+            &&  frame.AccelAxisTopToBottom == 0 && frame.GyroAxisFrontToBack == 0 
+            &&  frame.GyroAxisRightToLeft == 0 && frame.GyroAxisTopToBottom == 0)
+        {
+            noGyro->SendSignal();
+            noGyroCooldown = cNoGyroCooldownFrames;
+        }
+
+        int64_t diff = (int64_t)frame.Increment - (int64_t)lastInc;
+
+        if(lastInc != 0 && diff < 1 && diff > -100)
+        {
+            stats::Add(stats::CounterAdapterRepeated);
+            return false;
+        }
+
+        stats::Add(stats::CounterAdapterFrames);
+
+        if(lastInc != 0 && diff > 1)
+        {
+            // every gap is counted, only large ones are logged by default
+            if(diff <= cMaxDiffMissed)
+                stats::Add(stats::CounterAdapterMissed,diff-1);
+            LogF logMsg((diff > 6)?LogLevelDefault:LogLevelTrace);
+            logMsg << "CemuhookAdapter: Missed " << (diff-1) << " frames.";
+            if(frameServe != nullptr && batchPos == 1 && frameServe->GetMissedCount() > 0)
+                logMsg << " " << frameServe->GetMissedCount() << " of them overwritten before reading.";
+            if(diff > 1000)
+                { LogF(LogLevelTrace) << std::setw(8) << std::setfill('0') << std::setbase(16)
+                            << "Current increment: 0x" << frame.Increment << ". Last: 0x" << lastInc << "."; }
+            if(diff <= cMaxDiffReplicate)
+            {
+                logMsg << " Replicating...";
+                toReplicate = diff-1;
+            }
+        }
+
+        SetMotionData(frame,motion,lastAccelRtL,lastAccelFtB,lastAccelTtB);
+
+        // Timestamp locked to host clock. Frames without host time keep nominal timing.
+        uint64_t timestamp;
+        if(hostTimestamp != 0)
+        {
+            timestamp = clock.Update(frame.Increment,hostTimestamp)/1000;
+            periodUs = (uint64_t)(clock.GetPeriodNs()/1000.0 + 0.5);
+        }
+        else
+        {
+            timestamp = ToTimestamp(frame.Increment);
+            periodUs = SD_SCANTIME_US;
+        }
+
+        // Timestamps of replicated frames precede this one. Keep them increasing.
+        uint64_t replicated = toReplicate*periodUs;
+        lastTimestamp = (timestamp > lastTimestamp + replicated) ? timestamp - replicated : lastTimestamp + 1;
+        SetTimestamp(motion,lastTimestamp);
+
+        if(toReplicate > 0 && !isPersistent)
+            data = motion;
+            
+        lastInc = frame.Increment;
+        
+        return true;
+    }
+
+    int const& CemuhookAdapter::SetMotionDataNewFrame(MotionData &motion)
+    {
         static const int cMaxRepeatedLoop = 1000;
 
         if(noGyroCooldown > 0) --noGyroCooldown;
 
-        auto const& dataFrame = frameServe->GetPointer();
-
         if(ignoreFirst)
         {
-            auto lock = frameServe->GetConsumeLock();
             ignoreFirst = false;
+            // woken up by flush (pipeline is stopping)
+            if(!frameServe->WaitForData())
+                return toReplicate;
         }
 
         int repeatedLoop = cMaxRepeatedLoop;
@@ -135,91 +223,96 @@ namespace kmicki::sdgyrodsu
         {
             if(toReplicate == 0)
             {
-                //Log("DEBUG: TRY GET CONSUME LOCK.");
-                auto lock = frameServe->GetConsumeLock();
-                //Log("CONSUME LOCK ACQUIRED.");
-                auto const& frame = GetSdFrame(*dataFrame);
-
-                if( noGyroCooldown <= 0
-                    &&  frame.AccelAxisFrontToBack == 0 && frame.AccelAxisRightToLeft == 0 
-                    &&  frame.AccelAxisTopToBottom == 0 && frame.GyroAxisFrontToBack == 0 
-                    &&  frame.GyroAxisRightToLeft == 0 && frame.GyroAxisTopToBottom == 0)
+                // Frames that arrived since last call are all used,
+                // so that real samples are sent instead of replicated ones.
+                if(batchPos >= batchSize)
                 {
-                    NoGyro.SendSignal();
-                    noGyroCooldown = cNoGyroCooldownFrames;
+                    batchPos = 0;
+                    // woken up by flush (pipeline is stopping), motion data is left as it is
+                    if((batchSize = frameServe->WaitForBatch()) == 0)
+                        return toReplicate;
+                    stats::Add(stats::CounterServeOverrun,frameServe->GetMissedCount());
                 }
+                auto const& hidFrame = *frameServe->GetPointer(batchPos++);
+                auto const& frame = GetSdFrame(hidFrame);
+                trace::Stamp(trace::PointConsume,frame.Increment);
 
-                int64_t diff = (int64_t)frame.Increment - (int64_t)lastInc;
+                if(UseFrame(frame,hidFrame.Timestamp,motion))
+                    return toReplicate;
 
-                if(lastInc != 0 && diff < 1 && diff > -100)
+                if(repeatedLoop == cMaxRepeatedLoop)
                 {
-                    if(repeatedLoop == cMaxRepeatedLoop)
-                    {
-                        Log("CemuhookAdapter: Frame was repeated. Ignoring...",LogLevelDebug);
-                        { LogF(LogLevelTrace) << std::setw(8) << std::setfill('0') << std::setbase(16)
-                                        << "Current increment: 0x" << frame.Increment << ". Last: 0x" << lastInc << "."; }
-                    }
-                    if(repeatedLoop <= 0)
-                    {
-                        Log("CemuhookAdapter: Frame is repeated continously...");
-                        return toReplicate;
-                    }
-                    --repeatedLoop;
+                    Log("CemuhookAdapter: Frame was repeated. Ignoring...",LogLevelDebug);
+                    { LogF(LogLevelTrace) << std::setw(8) << std::setfill('0') << std::setbase(16)
+                                    << "Current increment: 0x" << frame.Increment << ". Last: 0x" << lastInc << "."; }
                 }
-                else
+                if(repeatedLoop <= 0)
                 {
-                    if(lastInc != 0 && diff > 1)
-                    {
-                        LogF logMsg((diff > 6)?LogLevelDefault:LogLevelDebug);
-                        logMsg << "CemuhookAdapter: Missed " << (diff-1) << " frames.";
-                        if(diff > 1000)
-                            { LogF(LogLevelTrace) << std::setw(8) << std::setfill('0') << std::setbase(16)
-                                     << "Current increment: 0x" << frame.Increment << ". Last: 0x" << lastInc << "."; }
-                        if(diff <= cMaxDiffReplicate)
-                        {
-                            logMsg << " Replicating...";
-                            toReplicate = diff-1;
-                        }
-                    }
-
-                    SetMotionData(frame,motion,lastAccelRtL,lastAccelFtB,lastAccelTtB);
-
-                    if(toReplicate > 0)
-                    {
-                        lastTimestamp = ToTimestamp(lastInc+1);
-                        SetTimestamp(motion,lastTimestamp);
-                        if(!isPersistent)
-                            data = motion;
-                    }
-                        
-                    lastInc = frame.Increment;
-                    
+                    Log("CemuhookAdapter: Frame is repeated continously...");
                     return toReplicate;
                 }
+                --repeatedLoop;
             }
             else
-            {
-                // Replicated frame
-                --toReplicate;
-                lastTimestamp += SD_SCANTIME_US;
-                if(!isPersistent)
-                {
-                    motion = SetTimestamp(data,lastTimestamp);
-                }
-                else
-                    SetTimestamp(motion,lastTimestamp);
+                return SetMotionDataReplicated(motion);
+        }
+    }
 
-                return toReplicate;
-            }
+    bool CemuhookAdapter::SetMotionDataFromFrame(frame_t const& frame, MotionData &motion)
+    {
+        if(noGyroCooldown > 0) --noGyroCooldown;
+
+        auto const& sdFrame = GetSdFrame(frame);
+        trace::Stamp(trace::PointConsume,sdFrame.Increment);
+
+        if(UseFrame(sdFrame,frame.Timestamp,motion))
+            return true;
+
+        Log("CemuhookAdapter: Frame was repeated. Ignoring...",LogLevelTrace);
+        return false;
+    }
+
+    int const& CemuhookAdapter::SetMotionDataReplicated(MotionData &motion)
+    {
+        if(toReplicate <= 0)
+            return toReplicate;
+
+        --toReplicate;
+        stats::Add(stats::CounterAdapterReplicated);
+        lastTimestamp += periodUs;
+        if(!isPersistent)
+        {
+            motion = SetTimestamp(data,lastTimestamp);
         }
+        else
+            SetTimestamp(motion,lastTimestamp);
+
+        return toReplicate;
+    }
+
+    void CemuhookAdapter::SetNoGyro(SignalOut & signal)
+    {
+        noGyro = &signal;
+    }
+
+    int const& CemuhookAdapter::GetToReplicate()
+    {
+        return toReplicate;
     }
 
     void CemuhookAdapter::StopFrameGrab()
     {
         Log("CemuhookAdapter: Stopping frame grab.",LogLevelDebug);
-        reader.StopServe(*frameServe);
+        if(reader == nullptr)
+            return;
+        reader->StopServe(*frameServe);
         frameServe = nullptr;
-        reader.Stop();
+        reader->Stop();
+    }
+
+    uint32_t const& CemuhookAdapter::GetLastIncrement()
+    {
+        return lastInc;
     }
 
     bool CemuhookAdapter::IsControllerConnected()
@@ -0,0 +1,114 @@
+#include "sdgyrodsu/clockrecovery.h"
+#include "log/log.h"
+
+using namespace kmicki::log;
+
+namespace kmicki::sdgyrodsu
+{
+    static const int cWindow = 256;             // frames in regression (~1 s at 250 Hz)
+    static const int cMinSamples = 32;          // fewer frames - assume nominal period
+    static const uint32_t cMaxGapFrames = 1000; // longer gap - start over
+    static const uint64_t cMaxGapNs = 1000000000;
+    static const int64_t cMaxResidualNs = 20000000;  // fit further from host time - start over
+    static const double cMinPeriodRatio = 0.5;  // fitted period limits relative to average period of the window
+    static const double cMaxPeriodRatio = 2.0;
+
+    ClockRecovery::ClockRecovery(uint64_t const& nominalPeriodNs)
+    : nominalPeriod(nominalPeriodNs), samples(cWindow)
+    {
+        Reset();
+    }
+
+    void ClockRecovery::Reset()
+    {
+        count = pos = 0;
+        counter = 0;
+        lastIncrement = 0;
+        lastTime = 0;
+        lastOutput = 0;
+        period = (double)nominalPeriod;
+    }
+
+    uint64_t ClockRecovery::Update(uint32_t const& increment, uint64_t const& hostTimeNs)
+    {
+        if(count > 0)
+        {
+            uint32_t delta = increment - lastIncrement;   // wraps around
+            if(delta == 0)
+                return lastOutput;
+            if(delta > cMaxGapFrames || hostTimeNs < lastTime || hostTimeNs - lastTime > cMaxGapNs)
+            {
+                Log("ClockRecovery: Frame timing lost. Starting over.",LogLevelDebug);
+                auto output = lastOutput;
+                Reset();
+                lastOutput = output;
+            }
+            else
+                counter += delta;
+        }
+
+        lastIncrement = increment;
+        lastTime = hostTimeNs;
+        samples[pos] = {counter, hostTimeNs};
+        pos = (pos+1)%cWindow;
+        if(count < cWindow)
+            ++count;
+
+        // Least squares relative to this frame to keep values small
+        double meanX = 0.0, meanY = 0.0;
+        for(int i = 0; i < count; ++i)
+        {
+            meanX += (double)(samples[i].counter - counter);
+            meanY += (double)(int64_t)(samples[i].time - hostTimeNs);
+        }
+        meanX /= count;
+        meanY /= count;
+
+        double sxx = 0.0, sxy = 0.0;
+        for(int i = 0; i < count; ++i)
+        {
+            double x = (double)(samples[i].counter - counter) - meanX;
+            double y = (double)(int64_t)(samples[i].time - hostTimeNs) - meanY;
+            sxx += x*x;
+            sxy += x*y;
+        }
+
+        // Average period between oldest and this frame. Fitted period is limited around it,
+        // so a source at any rate (synthetic frames, replay at max rate) is followed.
+        // Nominal period is used only until frames with distinct host times are there.
+        auto const& oldest = samples[(count < cWindow) ? 0 : pos];
+        double average = (counter > oldest.counter && hostTimeNs > oldest.time)
+                            ? (double)(hostTimeNs - oldest.time)/(double)(counter - oldest.counter)
+                            : (double)nominalPeriod;
+
+        double slope = (count >= cMinSamples && sxx > 0.0) ? sxy/sxx : average;
+        bool limited = slope < cMinPeriodRatio*average || slope > cMaxPeriodRatio*average;
+        if(limited)
+            slope = average;
+        period = slope;
+
+        // fitted time of this frame relative to its host time
+        // (limited slope doesn't follow the fit, so its distance isn't a divergence)
+        int64_t fit = (int64_t)(meanY - slope*meanX);
+        if(!limited && (fit > cMaxResidualNs || fit < -cMaxResidualNs))
+        {
+            Log("ClockRecovery: Frame timing diverged. Starting over.",LogLevelDebug);
+            auto output = lastOutput;
+            Reset();
+            lastOutput = output;
+            return Update(increment,hostTimeNs);
+        }
+
+        uint64_t output = hostTimeNs + fit;
+        if(output <= lastOutput)
+            output = lastOutput + 1;
+        lastOutput = output;
+
+        return output;
+    }
+
+    double const& ClockRecovery::GetPeriodNs() const
+    {
+        return period;
+    }
+}
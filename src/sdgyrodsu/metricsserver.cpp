@@ -0,0 +1,235 @@
+#include "sdgyrodsu/metricsserver.h"
+#include "trace/trace.h"
+#include "log/log.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace kmicki::log;
+
+namespace kmicki::sdgyrodsu
+{
+    static const int cRequestMaxLen = 4096;
+    static const int cConnectionTimeoutSec = 1;
+
+    MetricsServer::MetricsServer(std::string const& address, cemuhook::Server & _server)
+        : server(_server), unixPath(), socketFd(-1), stop(false)
+    {
+        Log("MetricsServer: Initializing.");
+
+        int result;
+        if(!address.empty() && address[0] == '/')
+        {
+            sockaddr_un sockAddr = {};
+            if(address.size() >= sizeof(sockAddr.sun_path))
+                throw std::runtime_error("MetricsServer: UNIX socket path is too long.");
+            socketFd = socket(AF_UNIX,SOCK_STREAM | SOCK_CLOEXEC,0);
+            if(socketFd < 0)
+                throw std::runtime_error("MetricsServer: Socket could not be created.");
+            sockAddr.sun_family = AF_UNIX;
+            strcpy(sockAddr.sun_path,address.c_str());
+            // socket left by previous run
+            unlink(address.c_str());
+            result = bind(socketFd,(sockaddr*)&sockAddr,sizeof(sockAddr));
+            unixPath = address;
+        }
+        else
+        {
+            int port = std::atoi(address.c_str());
+            if(port <= 0 || port > 65535)
+                throw std::runtime_error("MetricsServer: Invalid port.");
+            socketFd = socket(AF_INET,SOCK_STREAM | SOCK_CLOEXEC,0);
+            if(socketFd < 0)
+                throw std::runtime_error("MetricsServer: Socket could not be created.");
+            int reuse = 1;
+            setsockopt(socketFd,SOL_SOCKET,SO_REUSEADDR,&reuse,sizeof(reuse));
+            sockaddr_in sockAddr = {};
+            sockAddr.sin_family = AF_INET;
+            sockAddr.sin_port = htons(port);
+            sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            result = bind(socketFd,(sockaddr*)&sockAddr,sizeof(sockAddr));
+        }
+
+        if(result < 0 || listen(socketFd,4) < 0)
+        {
+            close(socketFd);
+            throw std::runtime_error("MetricsServer: Bind failed.");
+        }
+
+        thread.reset(new std::thread(&MetricsServer::serverTask,this));
+
+        { LogF() << "MetricsServer: Serving metrics at " << (unixPath.empty() ? "127.0.0.1:" : "") << address << "."; }
+    }
+
+    MetricsServer::~MetricsServer()
+    {
+        stop = true;
+        // wakes up blocked accept
+        shutdown(socketFd,SHUT_RDWR);
+        thread->join();
+        close(socketFd);
+        if(!unixPath.empty())
+            unlink(unixPath.c_str());
+        Log("MetricsServer: Stopped.");
+    }
+
+    void MetricsServer::serverTask()
+    {
+        pipeline::ApplyRealtimeProfile("sdgyro-metrics",pipeline::RealtimeProfile());
+
+        while(!stop)
+        {
+            int connectionFd = accept4(socketFd,nullptr,nullptr,SOCK_CLOEXEC);
+            if(connectionFd < 0)
+            {
+                if(errno != EINTR && errno != ECONNABORTED && !stop)
+                {
+                    Log("MetricsServer: Accepting connection failed.");
+                    break;
+                }
+                continue;
+            }
+            HandleConnection(connectionFd);
+            close(connectionFd);
+        }
+    }
+
+    // Write whole buffer to a connection.
+    static void WriteAll(int const& fd, std::string const& data)
+    {
+        size_t written = 0;
+        while(written < data.size())
+        {
+            auto result = send(fd,data.data()+written,data.size()-written,MSG_NOSIGNAL);
+            if(result < 0 && errno == EINTR)
+                continue;
+            if(result <= 0)
+                return;
+            written += result;
+        }
+    }
+
+    void MetricsServer::HandleConnection(int const& connectionFd)
+    {
+        timeval timeout = { cConnectionTimeoutSec, 0 };
+        setsockopt(connectionFd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+        setsockopt(connectionFd,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(timeout));
+
+        // headers of the request are read, body is not expected
+        std::string request;
+        char buf[512];
+        while(request.size() < cRequestMaxLen && request.find("\r\n\r\n") == std::string::npos)
+        {
+            auto result = recv(connectionFd,buf,sizeof(buf),0);
+            if(result < 0 && errno == EINTR)
+                continue;
+            if(result <= 0)
+                break;
+            request.append(buf,result);
+        }
+
+        auto lineEnd = request.find("\r\n");
+        std::istringstream requestLine(request.substr(0,lineEnd));
+        std::string method, path;
+        requestLine >> method >> path;
+
+        std::string status, contentType, body;
+        if(method != "GET")
+        {
+            status = "405 Method Not Allowed";
+            contentType = "text/plain";
+            body = "Method not allowed.\n";
+        }
+        else if(path == "/metrics" || path == "/")
+        {
+            status = "200 OK";
+            contentType = "text/plain; version=0.0.4";
+            body = GetMetrics();
+        }
+        else
+        {
+            status = "404 Not Found";
+            contentType = "text/plain";
+            body = "Metrics are at /metrics.\n";
+        }
+
+        std::ostringstream response;
+        response << "HTTP/1.0 " << status << "\r\n"
+                 << "Content-Type: " << contentType << "\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        WriteAll(connectionFd,response.str());
+    }
+
+    // Header of a metric.
+    static void Describe(std::ostream & out, char const* name, char const* type, char const* help)
+    {
+        out << "# HELP sdgyro_" << name << " " << help << "\n"
+            << "# TYPE sdgyro_" << name << " " << type << "\n";
+    }
+
+    std::string MetricsServer::GetMetrics()
+    {
+        static const double cQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+        std::ostringstream out;
+        auto snapshot = stats::GetSnapshot();
+
+        for(int i = 0; i < stats::CounterCount; ++i)
+        {
+            auto counter = (stats::Counter)i;
+            auto name = std::string(stats::GetName(counter)) + "_total";
+            Describe(out,name.c_str(),"counter",stats::GetDescription(counter));
+            out << "sdgyro_" << name << " " << snapshot[counter] << "\n";
+        }
+
+        auto clients = server.GetClients();
+        Describe(out,"clients","gauge","DSU clients subscribed for data");
+        out << "sdgyro_clients " << clients.size() << "\n";
+
+        Describe(out,"client_packets_total","counter","Data packets sent to a DSU client");
+        for(auto const& client : clients)
+        {
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET,&client.address.sin_addr,ip,sizeof(ip));
+            auto address = std::string(ip) + ":" + std::to_string(ntohs(client.address.sin_port));
+            auto labels = "{address=\"" + address + "\",slots=\"" + std::to_string(client.slots) + "\"}";
+
+            out << "sdgyro_client_packets_total" << labels << " " << client.packets << "\n";
+        }
+
+        Describe(out,"log_dropped_total","counter","Log messages dropped because a log queue was full");
+        out << "sdgyro_log_dropped_total " << GetDroppedLogCount() << "\n";
+
+        // latencies are measured only if tracing is enabled
+        if(trace::IsEnabled())
+        {
+            Describe(out,"latency_seconds","summary","Latency between points of the pipeline (quantiles since start)");
+            for(int from = trace::PointRead; from < trace::PointCount; ++from)
+                for(int to = from+1; to < trace::PointCount; ++to)
+                {
+                    auto const& hist = trace::GetHistogram((trace::Point)from,(trace::Point)to);
+                    if(hist.GetCount() == 0)
+                        continue;
+                    auto labels = std::string("from=\"") + trace::GetPointName((trace::Point)from)
+                                + "\",to=\"" + trace::GetPointName((trace::Point)to) + "\"";
+                    for(auto quantile : cQuantiles)
+                        out << "sdgyro_latency_seconds{" << labels << ",quantile=\"" << quantile << "\"} "
+                            << hist.GetPercentile(quantile)/1e9 << "\n";
+                    out << "sdgyro_latency_seconds{" << labels << ",quantile=\"1\"} " << hist.GetMax()/1e9 << "\n";
+                    out << "sdgyro_latency_seconds_sum{" << labels << "} " << hist.GetSum()/1e9 << "\n";
+                    out << "sdgyro_latency_seconds_count{" << labels << "} " << hist.GetCount() << "\n";
+                }
+        }
+
+        return out.str();
+    }
+}
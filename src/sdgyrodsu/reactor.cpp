@@ -0,0 +1,301 @@
+#include "sdgyrodsu/reactor.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+
+using namespace kmicki::log;
+
+namespace kmicki::sdgyrodsu
+{
+    static const int cMaxEvents = 8;
+    static const int cTimerPeriodSec = 2;   // client timeout tick and device reopening period
+
+    Reactor::Reactor(uint16_t const& vId, uint16_t const& pId, int const& interfaceNumber, int const& frameLen, std::vector<char> const& _startMarker, bool const& _ioUring)
+    : device(vId,pId,interfaceNumber), adapter(), server(adapter,true),
+      frame(frameLen), startMarker(_startMarker), motion(),
+      epollFd(-1), timerFd(-1), signalFd(-1), stop(false), sending(false), ioUring(_ioUring)
+    {
+        Init();
+    }
+
+    Reactor::Reactor(std::string const& devicePath, int const& frameLen, std::vector<char> const& _startMarker, bool const& _ioUring)
+    : device(devicePath), adapter(), server(adapter,true),
+      frame(frameLen), startMarker(_startMarker), motion(),
+      epollFd(-1), timerFd(-1), signalFd(-1), stop(false), sending(false), ioUring(_ioUring)
+    {
+        Init();
+    }
+
+    void Reactor::Init()
+    {
+#ifndef SDGYRO_IO_URING
+        if(ioUring)
+        {
+            Log("Reactor: Built without io_uring. Using epoll.");
+            ioUring = false;
+        }
+#endif
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if(epollFd < 0)
+            throw std::runtime_error("Reactor: Failed to create epoll instance.");
+
+        timerFd = timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+        if(timerFd < 0)
+            throw std::runtime_error("Reactor: Failed to create timer.");
+
+        itimerspec period = {};
+        period.it_interval.tv_sec = cTimerPeriodSec;
+        period.it_value.tv_sec = cTimerPeriodSec;
+        timerfd_settime(timerFd,0,&period,nullptr);
+
+#ifdef SDGYRO_IO_URING
+        if(ioUring)
+        {
+            InitUring();
+            Log("Reactor: Initialized with io_uring.",LogLevelDebug);
+            return;
+        }
+#endif
+
+        Watch(timerFd);
+        Watch(server.GetSocketFd());
+
+        Log("Reactor: Initialized.",LogLevelDebug);
+    }
+
+    Reactor::~Reactor()
+    {
+        CloseDevice();
+#ifdef SDGYRO_IO_URING
+        if(ioUring)
+            CloseUring();
+#endif
+        if(signalFd >= 0)
+            close(signalFd);
+        if(timerFd >= 0)
+            close(timerFd);
+        if(epollFd >= 0)
+            close(epollFd);
+    }
+
+    void Reactor::Watch(int fd)
+    {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if(epoll_ctl(epollFd,EPOLL_CTL_ADD,fd,&event) < 0)
+            throw std::runtime_error("Reactor: Failed to watch file descriptor.");
+    }
+
+    void Reactor::OpenDevice()
+    {
+        if(!device.Open())
+            return;
+
+        { LogF() << "Reactor: Opened HID device " << device.GetPath() << "."; }
+
+#ifdef SDGYRO_IO_URING
+        if(ioUring)
+        {
+            ArmRead();
+            return;
+        }
+#endif
+        Watch(device.GetFd());
+    }
+
+    void Reactor::CloseDevice()
+    {
+        if(!device.IsOpen())
+            return;
+#ifdef SDGYRO_IO_URING
+        if(ioUring)
+            CancelRead();
+        else
+#endif
+            epoll_ctl(epollFd,EPOLL_CTL_DEL,device.GetFd(),nullptr);
+        device.Close();
+    }
+
+    void Reactor::Run()
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals,SIGINT);
+        sigaddset(&signals,SIGTERM);
+        sigaddset(&signals,SIGUSR1);
+        pthread_sigmask(SIG_BLOCK,&signals,nullptr);
+
+        signalFd = signalfd(-1,&signals,SFD_NONBLOCK | SFD_CLOEXEC);
+        if(signalFd < 0)
+            throw std::runtime_error("Reactor: Failed to create signal file descriptor.");
+
+#ifdef SDGYRO_IO_URING
+        if(ioUring)
+        {
+            RunUring();
+            return;
+        }
+#endif
+        Watch(signalFd);
+
+        OpenDevice();
+        if(!device.IsOpen())
+            Log("Reactor: HID device not found. Retrying periodically.");
+
+        Log("Reactor: Started.");
+
+        epoll_event events[cMaxEvents];
+
+        while(!stop)
+        {
+            auto eventCnt = epoll_wait(epollFd,events,cMaxEvents,-1);
+            if(eventCnt < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                throw std::runtime_error("Reactor: Waiting for events failed.");
+            }
+
+            for(int i = 0; i < eventCnt; ++i)
+            {
+                auto fd = events[i].data.fd;
+                if(fd == device.GetFd())
+                {
+                    if(events[i].events & (EPOLLERR | EPOLLHUP))
+                    {
+                        Log("Reactor: HID device disconnected.");
+                        CloseDevice();
+                    }
+                    else
+                        HandleDevice();
+                }
+                else if(fd == server.GetSocketFd())
+                    server.ReceiveRequests();
+                else if(fd == timerFd)
+                    HandleTimer();
+                else if(fd == signalFd)
+                    HandleSignal();
+            }
+        }
+
+        Log("Reactor: Stopped.");
+    }
+
+    void Reactor::HandleDevice()
+    {
+        static const int cMaxReportsPerEvent = 16;
+
+        for(int i = 0; i < cMaxReportsPerEvent; ++i)
+        {
+            auto readCnt = device.Read(frame);
+            if(readCnt == 0)
+                return;
+            frame.Timestamp = hiddev::GetMonotonicNs();
+            if(readCnt < 0)
+            {
+                Log("Reactor: Reading HID device failed.");
+                CloseDevice();
+                return;
+            }
+            if(readCnt < frame.size() || memcmp(frame.data(),startMarker.data(),startMarker.size()) != 0)
+            {
+                stats::Add(stats::CounterReadUnsynced);
+                continue;
+            }
+
+            HandleFrame();
+        }
+    }
+
+    void Reactor::HandleFrame()
+    {
+        trace::Stamp(trace::PointRead,GetSdFrame(frame).Increment);
+        stats::Add(stats::CounterReadFrames);
+
+        if(!server.HasClients())
+        {
+            if(sending)
+            {
+                adapter.StopFrameGrab();
+                sending = false;
+            }
+            return;
+        }
+
+        if(!sending)
+        {
+            adapter.StartFrameGrab();
+            sending = true;
+        }
+
+        if(adapter.NoGyro.TrySignal())
+        {
+            Log("Reactor: Try reenabling gyro.",LogLevelTrace);
+            stats::Add(stats::CounterReadGyroEnable);
+            if(device.EnableGyro())
+                Log("Reactor: Gyro reenabled.",LogLevelDebug);
+            else
+            {
+                stats::Add(stats::CounterReadGyroEnableFailed);
+                Log("Reactor: Gyro reenaling failed.");
+            }
+        }
+
+        if(!adapter.SetMotionDataFromFrame(frame,motion))
+            return;
+
+        server.SendData(motion);
+        while(adapter.GetToReplicate() > 0)
+        {
+            adapter.SetMotionDataReplicated(motion);
+            server.SendData(motion);
+        }
+    }
+
+    void Reactor::HandleTimer()
+    {
+        uint64_t expirations;
+        if(read(timerFd,&expirations,sizeof(expirations)) != sizeof(expirations))
+            return;
+
+        server.TickClientTimeout();
+        stats::Tick();
+
+        if(!device.IsOpen())
+            OpenDevice();
+    }
+
+    void Reactor::HandleSignal()
+    {
+        signalfd_siginfo info;
+        while(read(signalFd,&info,sizeof(info)) == sizeof(info))
+        {
+            switch(info.ssi_signo)
+            {
+                case SIGINT:
+                    Log("Incoming signal: SIGINT");
+                    stop = true;
+                    break;
+                case SIGTERM:
+                    Log("Incoming signal: SIGTERM");
+                    stop = true;
+                    break;
+                case SIGUSR1:
+                    Log("Incoming signal: SIGUSR1");
+                    stats::LogSummary();
+                    trace::Dump();
+                    break;
+            }
+        }
+    }
+}
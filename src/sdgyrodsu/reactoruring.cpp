@@ -0,0 +1,314 @@
+#ifdef SDGYRO_IO_URING
+
+#include "sdgyrodsu/reactor.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include "stats/stats.h"
+
+#include <sys/socket.h>
+#include <poll.h>
+#include <cstring>
+#include <stdexcept>
+
+using namespace kmicki::log;
+
+namespace kmicki::sdgyrodsu
+{
+    static const unsigned cRingEntries = 256;
+    static const unsigned cReadBufferCount = 16;    // power of 2
+    static const int cReadBufferGroup = 0;
+
+    // User data of submissions other than sends (sends carry pointer to their Send)
+    enum UringTag : uint64_t
+    {
+        UringTagRead = 1,
+        UringTagSocket,
+        UringTagTimer,
+        UringTagSignal,
+        UringTagCancel,
+        UringTagLast
+    };
+
+    void Reactor::InitUring()
+    {
+        readBuffers = nullptr;
+        readMultishot = true;
+        readArmed = false;
+        lastSend = nullptr;
+
+        if(io_uring_queue_init(cRingEntries,&ring,0) < 0)
+            throw std::runtime_error("Reactor: Failed to initialize io_uring.");
+
+        int error;
+        readBuffers = io_uring_setup_buf_ring(&ring,cReadBufferCount,cReadBufferGroup,0,&error);
+        if(readBuffers == nullptr)
+        {
+            io_uring_queue_exit(&ring);
+            throw std::runtime_error("Reactor: Failed to register io_uring read buffers.");
+        }
+
+        auto len = frame.size();
+        readBufferData.resize(cReadBufferCount*len);
+        for(unsigned i = 0; i < cReadBufferCount; ++i)
+            io_uring_buf_ring_add(readBuffers,readBufferData.data()+i*len,len,i,io_uring_buf_ring_mask(cReadBufferCount),i);
+        io_uring_buf_ring_advance(readBuffers,cReadBufferCount);
+
+        server.SetSender([this](iovec const* vecs, int const& count, sockaddr_in const& address)
+        {
+            QueueSend(vecs,count,address);
+        });
+    }
+
+    void Reactor::CloseUring()
+    {
+        server.SetSender(cemuhook::Server::sender_t());
+        io_uring_free_buf_ring(&ring,readBuffers,cReadBufferCount,cReadBufferGroup);
+        io_uring_queue_exit(&ring);
+    }
+
+    io_uring_sqe * Reactor::GetSqe()
+    {
+        auto sqe = io_uring_get_sqe(&ring);
+        while(sqe == nullptr)
+        {
+            // Submission queue full. Link of sends can't continue past submission.
+            lastSend = nullptr;
+            auto result = io_uring_submit(&ring);
+            if(result == -EBUSY)
+            {
+                // Completion queue full (sends to many clients). Make room before submitting again.
+                if(ReapCompletions() == 0)
+                {
+                    io_uring_cqe * cqe;
+                    io_uring_wait_cqe(&ring,&cqe);
+                    ReapCompletions();
+                }
+            }
+            else if(result < 0 && result != -EINTR && result != -EAGAIN)
+                throw std::runtime_error("Reactor: Submitting to io_uring failed.");
+            sqe = io_uring_get_sqe(&ring);
+        }
+        return sqe;
+    }
+
+    unsigned Reactor::ReapCompletions()
+    {
+        // Sends are completed right away. Other completions are handled later by the loop,
+        // because this may be called while handling one of them.
+        unsigned head;
+        unsigned count = 0;
+        io_uring_cqe * cqe;
+        io_uring_for_each_cqe(&ring,head,cqe)
+        {
+            ++count;
+            if(io_uring_cqe_get_data64(cqe) < UringTagLast)
+            {
+                completions.push_back(*cqe);
+                continue;
+            }
+
+            auto send = reinterpret_cast<Send*>(io_uring_cqe_get_data(cqe));
+            if(cqe->res < 0)
+            {
+                stats::Add(stats::CounterServerSendFailed);
+                { LogF(LogLevelTrace) << "Reactor: Sending data failed (" << -cqe->res << ")."; }
+            }
+            else
+                stats::Add(stats::CounterServerPackets);
+            freeSends.push_back(send);
+        }
+        io_uring_cq_advance(&ring,count);
+        return count;
+    }
+
+    void Reactor::HandleCompletion(io_uring_cqe const& cqe)
+    {
+        bool rearm = !(cqe.flags & IORING_CQE_F_MORE);
+        switch(io_uring_cqe_get_data64(&cqe))
+        {
+            case UringTagRead:
+                HandleRead(&cqe);
+                break;
+            case UringTagSocket:
+                server.ReceiveRequests();
+                if(rearm)
+                    ArmPoll(server.GetSocketFd(),UringTagSocket);
+                break;
+            case UringTagTimer:
+                HandleTimer();
+                if(rearm)
+                    ArmPoll(timerFd,UringTagTimer);
+                break;
+            case UringTagSignal:
+                HandleSignal();
+                if(rearm)
+                    ArmPoll(signalFd,UringTagSignal);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void Reactor::ArmRead()
+    {
+        if(readArmed || !device.IsOpen())
+            return;
+
+        auto sqe = GetSqe();
+        if(readMultishot)
+            io_uring_prep_read_multishot(sqe,device.GetFd(),0,0,cReadBufferGroup);
+        else
+        {
+            io_uring_prep_read(sqe,device.GetFd(),nullptr,frame.size(),0);
+            sqe->flags |= IOSQE_BUFFER_SELECT;
+            sqe->buf_group = cReadBufferGroup;
+        }
+        io_uring_sqe_set_data64(sqe,UringTagRead);
+        readArmed = true;
+    }
+
+    void Reactor::CancelRead()
+    {
+        // pending read holds the file, cancel it before the file is closed
+        auto sqe = GetSqe();
+        io_uring_prep_cancel_fd(sqe,device.GetFd(),IORING_ASYNC_CANCEL_ALL);
+        io_uring_sqe_set_data64(sqe,UringTagCancel);
+        io_uring_submit(&ring);
+        readArmed = false;
+    }
+
+    void Reactor::ArmPoll(int fd, uint64_t tag)
+    {
+        auto sqe = GetSqe();
+        io_uring_prep_poll_multishot(sqe,fd,POLLIN);
+        io_uring_sqe_set_data64(sqe,tag);
+    }
+
+    void Reactor::QueueSend(iovec const* vecs, int const& count, sockaddr_in const& address)
+    {
+        Send * send;
+        if(freeSends.empty())
+        {
+            sends.emplace_back(new Send());
+            send = sends.back().get();
+        }
+        else
+        {
+            send = freeSends.back();
+            freeSends.pop_back();
+        }
+
+        // packet is copied, it has to stay intact until the send completes
+        send->data.clear();
+        for(int i = 0; i < count; ++i)
+            send->data.insert(send->data.end(),(char const*)vecs[i].iov_base,(char const*)vecs[i].iov_base+vecs[i].iov_len);
+        send->address = address;
+        send->vec.iov_base = send->data.data();
+        send->vec.iov_len = send->data.size();
+        memset(&send->message,0,sizeof(send->message));
+        send->message.msg_name = &send->address;
+        send->message.msg_namelen = sizeof(send->address);
+        send->message.msg_iov = &send->vec;
+        send->message.msg_iovlen = 1;
+
+        auto sqe = GetSqe();
+        io_uring_prep_sendmsg(sqe,server.GetSocketFd(),&send->message,0);
+        io_uring_sqe_set_data(sqe,send);
+
+        // Sends of a frame are linked, so that they go out in order in one submission.
+        // Hard link - failed send to one client doesn't cancel the others.
+        if(lastSend != nullptr)
+            lastSend->flags |= IOSQE_IO_HARDLINK;
+        lastSend = sqe;
+    }
+
+    void Reactor::HandleRead(io_uring_cqe const* cqe)
+    {
+        if(cqe->res == -ECANCELED)
+            return;     // device was closed
+
+        if(!(cqe->flags & IORING_CQE_F_MORE))
+            readArmed = false;
+
+        if(cqe->res < 0)
+        {
+            if(cqe->res == -EINVAL && readMultishot)
+            {
+                Log("Reactor: Multishot read not supported by kernel. Reading each report separately.",LogLevelDebug);
+                readMultishot = false;
+            }
+            else if(cqe->res != -ENOBUFS)
+            {
+                Log("Reactor: Reading HID device failed.");
+                CloseDevice();
+                return;
+            }
+        }
+        else if(cqe->res == 0)
+        {
+            Log("Reactor: HID device disconnected.");
+            CloseDevice();
+            return;
+        }
+
+        if(cqe->flags & IORING_CQE_F_BUFFER)
+        {
+            unsigned short bufferId = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            auto len = frame.size();
+            char * data = readBufferData.data()+bufferId*len;
+
+            if(cqe->res >= (int)len && memcmp(data,startMarker.data(),startMarker.size()) == 0)
+            {
+                memcpy(frame.data(),data,len);
+                frame.Timestamp = hiddev::GetMonotonicNs();
+                HandleFrame();
+                lastSend = nullptr;
+            }
+            else
+                stats::Add(stats::CounterReadUnsynced);
+
+            io_uring_buf_ring_add(readBuffers,data,len,bufferId,io_uring_buf_ring_mask(cReadBufferCount),0);
+            io_uring_buf_ring_advance(readBuffers,1);
+        }
+
+        ArmRead();
+    }
+
+    void Reactor::RunUring()
+    {
+        ArmPoll(server.GetSocketFd(),UringTagSocket);
+        ArmPoll(timerFd,UringTagTimer);
+        ArmPoll(signalFd,UringTagSignal);
+
+        OpenDevice();
+        if(!device.IsOpen())
+            Log("Reactor: HID device not found. Retrying periodically.");
+
+        Log("Reactor: Started with io_uring.");
+
+        while(!stop)
+        {
+            // Sends queued while handling previous completions are submitted with the wait
+            auto result = io_uring_submit_and_wait(&ring,1);
+            if(result < 0 && result != -EBUSY && result != -EAGAIN)
+            {
+                if(result == -EINTR)
+                    continue;
+                throw std::runtime_error("Reactor: Waiting for completions failed.");
+            }
+
+            // Handling may queue sends and reap more completions (appended to the list)
+            ReapCompletions();
+            for(size_t i = 0; i < completions.size(); ++i)
+            {
+                auto cqe = completions[i];
+                HandleCompletion(cqe);
+            }
+            completions.clear();
+        }
+
+        Log("Reactor: Stopped.");
+    }
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "sdgyrodsu/shmpublisher.h"
+#include "sdgyrodsu/sdhidframe.h"
+#include "pipeline/futex.h"
+#include "log/log.h"
+#include "stats/stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace kmicki::log;
+using namespace kmicki::cemuhook::protocol;
+
+namespace kmicki::sdgyrodsu
+{
+    ShmPublisher::ShmPublisher(std::vector<hiddev::HidDevReader*> const& readers, std::vector<SignalOut*> const& noGyro,
+                               pipeline::RealtimeProfile const& _profile)
+        : shm(nullptr), slots(SDGYRO_SHM_SLOTS), profile(_profile), stop(false)
+    {
+        Log("ShmPublisher: Initializing.");
+
+        int fd = shm_open(SDGYRO_SHM_NAME,O_CREAT | O_RDWR,0600);
+        if(fd < 0)
+            throw std::runtime_error("ShmPublisher: Shared memory could not be created.");
+
+        if(ftruncate(fd,sizeof(sdgyro_shm)) < 0)
+        {
+            close(fd);
+            throw std::runtime_error("ShmPublisher: Shared memory could not be resized.");
+        }
+
+        auto map = mmap(nullptr,sizeof(sdgyro_shm),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        close(fd);
+        if(map == MAP_FAILED)
+            throw std::runtime_error("ShmPublisher: Shared memory could not be mapped.");
+
+        // readers of previous run see magic change first, layout is filled before it is set
+        shm = reinterpret_cast<sdgyro_shm*>(map);
+        std::atomic_ref<uint32_t>(shm->magic).store(0,std::memory_order_relaxed);
+        memset(reinterpret_cast<char*>(shm)+sizeof(shm->magic),0,sizeof(sdgyro_shm)-sizeof(shm->magic));
+        shm->version = SDGYRO_SHM_VERSION;
+        shm->slot_count = SDGYRO_SHM_SLOTS;
+        shm->depth = SDGYRO_SHM_DEPTH;
+        shm->record_size = sizeof(sdgyro_shm_record);
+        shm->publisher_pid = getpid();
+
+        for(int i = 0; i < SDGYRO_SHM_SLOTS; ++i)
+        {
+            slots[i].reader = (i < readers.size()) ? readers[i] : nullptr;
+            shm->slots[i].active = slots[i].reader != nullptr;
+        }
+        std::atomic_ref<uint32_t>(shm->magic).store(SDGYRO_SHM_MAGIC,std::memory_order_release);
+
+        for(int i = 0; i < SDGYRO_SHM_SLOTS; ++i)
+        {
+            if(slots[i].reader == nullptr)
+                continue;
+            slots[i].adapter.reset(new CemuhookAdapter());
+            if(i < noGyro.size() && noGyro[i] != nullptr)
+                slots[i].adapter->SetNoGyro(*noGyro[i]);
+            slots[i].thread.reset(new std::thread(&ShmPublisher::publishTask,this,i));
+        }
+
+        { LogF() << "ShmPublisher: Publishing into shared memory " << SDGYRO_SHM_NAME << "."; }
+    }
+
+    ShmPublisher::~ShmPublisher()
+    {
+        stop = true;
+        for(auto & slot : slots)
+            if(slot.thread.get() != nullptr)
+                slot.thread->join();
+
+        for(int i = 0; i < SDGYRO_SHM_SLOTS; ++i)
+            shm->slots[i].active = 0;
+        munmap(shm,sizeof(sdgyro_shm));
+        // readers that have it mapped keep it until they unmap it
+        shm_unlink(SDGYRO_SHM_NAME);
+        Log("ShmPublisher: Stopped.");
+    }
+
+    void ShmPublisher::publishTask(int slotNo)
+    {
+        static const auto cWaitTimeout = std::chrono::milliseconds(100);
+
+        auto & slot = slots[slotNo];
+
+        pipeline::ApplyRealtimeProfile("sdgyro-shm"+std::to_string(slotNo),profile);
+
+        // pipeline keeps running for the publisher even if there are no DSU clients
+        slot.reader->Start();
+        auto & serve = slot.reader->GetServe();
+        slot.adapter->StartFrameGrab();
+
+        { LogF(LogLevelDebug) << "ShmPublisher: Start publishing slot " << slotNo << "."; }
+
+        MotionData motion;
+        while(!stop)
+        {
+            if(!serve.WaitForData(cWaitTimeout))
+                continue;
+            stats::Add(stats::CounterServeOverrun,serve.GetMissedCount());
+            auto const& frame = *serve.GetPointer();
+            if(!slot.adapter->SetMotionDataFromFrame(frame,motion))
+                continue;
+            Publish(slotNo,frame,motion);
+        }
+
+        slot.adapter->StopFrameGrab();
+        slot.reader->StopServe(serve);
+        slot.reader->Stop();
+
+        { LogF(LogLevelDebug) << "ShmPublisher: Stop publishing slot " << slotNo << "."; }
+    }
+
+    void ShmPublisher::Publish(int const& slotNo, frame_t const& frame, MotionData const& motion)
+    {
+        auto & shmSlot = shm->slots[slotNo];
+        std::atomic_ref<uint32_t> published(shmSlot.published);
+
+        // single writer of the slot
+        auto n = published.load(std::memory_order_relaxed);
+        auto & record = shmSlot.records[n % SDGYRO_SHM_DEPTH];
+        std::atomic_ref<uint32_t> sequence(record.sequence);
+
+        sequence.store(2*n+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        record.increment = GetSdFrame(frame).Increment;
+        record.host_time_ns = frame.Timestamp;
+        record.motion.timestamp_us = (uint64_t)motion.timestampH << 32 | motion.timestampL;
+        record.motion.acc_x = motion.accX;
+        record.motion.acc_y = motion.accY;
+        record.motion.acc_z = motion.accZ;
+        record.motion.pitch = motion.pitch;
+        record.motion.yaw = motion.yaw;
+        record.motion.roll = motion.roll;
+        record.frame_len = std::min<size_t>(frame.size(),SDGYRO_SHM_FRAME_LEN);
+        memcpy(record.frame,frame.data(),record.frame_len);
+
+        sequence.store(2*n+2,std::memory_order_release);
+        published.store(n+1,std::memory_order_seq_cst);
+
+        // system call only if some reader blocks
+        if(std::atomic_ref<uint32_t>(shmSlot.waiters).load(std::memory_order_seq_cst) > 0)
+            pipeline::FutexWakeAllShared(&shmSlot.published);
+    }
+}
@@ -0,0 +1,142 @@
+#include "stats/stats.h"
+#include "log/log.h"
+
+#include <mutex>
+#include <iomanip>
+
+using namespace kmicki::log;
+
+namespace kmicki::stats
+{
+    namespace detail
+    {
+        Slot counters[CounterCount] = {};
+    }
+
+    namespace
+    {
+        const char * cCounterNames[CounterCount] =
+        {
+            "read_frames", "read_dropped", "read_unsynced", "read_gyro_enable", "read_gyro_enable_failed",
+            "process_frames", "process_dropped",
+            "serve_overrun",
+            "adapter_frames", "adapter_missed", "adapter_replicated", "adapter_repeated",
+            "server_packets", "server_send_failed", "server_clients_added", "server_clients_timed_out"
+        };
+
+        const char * cCounterDescriptions[CounterCount] =
+        {
+            "Frames read from device",
+            "Read frames overwritten before being processed",
+            "Incomplete reads or reads starting in the middle of a frame",
+            "Attempts to reenable gyro after it stopped reporting",
+            "Failed attempts to reenable gyro",
+            "Hiddev records processed into frames",
+            "Processed frames overwritten before being served",
+            "Served frames overwritten before a consumer read them",
+            "Frames converted to motion data",
+            "Frames missing in the sequence of increments",
+            "Motion samples replicated in place of missed frames",
+            "Repeated frames that were ignored",
+            "Data packets sent to clients",
+            "Data packets that failed to be sent",
+            "Clients that subscribed for data",
+            "Clients removed after no request for some time"
+        };
+
+        uint64_t Now()
+        {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        const uint64_t startTimeNs = Now();
+
+        std::mutex summaryMutex;
+        std::chrono::seconds summaryPeriod(0);
+        Snapshot lastSummary = { startTimeNs };
+
+        double Percent(uint64_t part, uint64_t total)
+        {
+            return (total == 0) ? 0.0 : 100.0*part/total;
+        }
+
+        // Log differences between two snapshots.
+        void LogDifference(char const* title, Snapshot const& from, Snapshot const& to)
+        {
+            uint64_t d[CounterCount];
+            for(int i = 0; i < CounterCount; ++i)
+                d[i] = to.values[i] - from.values[i];
+
+            { LogF() << "Stats: " << title << " (" << std::fixed << std::setprecision(1) << (to.timeNs - from.timeNs)/1e9 << " s):"; }
+            { LogF() << "Stats:   read:    " << d[CounterReadFrames] << " frames, dropped: " << d[CounterReadDropped]
+                     << std::fixed << std::setprecision(3) << " (" << Percent(d[CounterReadDropped],d[CounterReadFrames]) << "%)"
+                     << ", unsynced: " << d[CounterReadUnsynced]
+                     << ", gyro reenabled: " << d[CounterReadGyroEnable] << " (failed: " << d[CounterReadGyroEnableFailed] << ")"; }
+            { LogF() << "Stats:   process: " << d[CounterProcessFrames] << " frames, dropped: " << d[CounterProcessDropped]
+                     << std::fixed << std::setprecision(3) << " (" << Percent(d[CounterProcessDropped],d[CounterProcessFrames]) << "%)"; }
+            { LogF() << "Stats:   serve:   overrun: " << d[CounterServeOverrun]; }
+            { LogF() << "Stats:   adapter: " << d[CounterAdapterFrames] << " frames, missed: " << d[CounterAdapterMissed]
+                     << std::fixed << std::setprecision(3) << " (" << Percent(d[CounterAdapterMissed],d[CounterAdapterFrames]+d[CounterAdapterMissed]) << "%)"
+                     << ", replicated: " << d[CounterAdapterReplicated] << ", repeated: " << d[CounterAdapterRepeated]; }
+            { LogF() << "Stats:   server:  " << d[CounterServerPackets] << " packets, failed: " << d[CounterServerSendFailed]
+                     << std::fixed << std::setprecision(3) << " (" << Percent(d[CounterServerSendFailed],d[CounterServerPackets]+d[CounterServerSendFailed]) << "%)"
+                     << ", clients: " << to[CounterServerClientsAdded] - to[CounterServerClientsTimedOut]
+                     << " (added: " << d[CounterServerClientsAdded] << ", timed out: " << d[CounterServerClientsTimedOut] << ")"; }
+        }
+    }
+
+    Snapshot GetSnapshot()
+    {
+        Snapshot snapshot;
+        snapshot.timeNs = Now();
+        for(int i = 0; i < CounterCount; ++i)
+            snapshot.values[i] = detail::counters[i].value.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    char const* GetName(Counter counter)
+    {
+        return cCounterNames[counter];
+    }
+
+    char const* GetDescription(Counter counter)
+    {
+        return cCounterDescriptions[counter];
+    }
+
+    void SetSummaryPeriod(std::chrono::seconds period)
+    {
+        std::lock_guard lock(summaryMutex);
+        summaryPeriod = period;
+        lastSummary = GetSnapshot();
+    }
+
+    void Tick()
+    {
+        {
+            std::lock_guard lock(summaryMutex);
+            if(summaryPeriod.count() <= 0
+               || Now() - lastSummary.timeNs < (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(summaryPeriod).count())
+                return;
+        }
+        LogSummary();
+    }
+
+    void LogSummary()
+    {
+        std::lock_guard lock(summaryMutex);
+        auto snapshot = GetSnapshot();
+        if(snapshot[CounterReadFrames] != lastSummary[CounterReadFrames])
+            LogDifference("Since previous summary",lastSummary,snapshot);
+        lastSummary = snapshot;
+    }
+
+    void LogTotals()
+    {
+        auto snapshot = GetSnapshot();
+        if(snapshot[CounterReadFrames] == 0)
+            return;
+        LogDifference("Totals",{ startTimeNs },snapshot);
+    }
+}
@@ -0,0 +1,213 @@
+#include "trace/trace.h"
+#include "log/log.h"
+
+#include <chrono>
+#include <memory>
+#include <iomanip>
+
+using namespace kmicki::log;
+
+namespace kmicki::trace
+{
+    // Definition - Histogram
+
+    Histogram::Histogram()
+    : count(0), sum(0), max(0)
+    {
+        Reset();
+    }
+
+    int Histogram::GetIndex(uint64_t value)
+    {
+        if(value < (1 << cSubBucketBits))
+            return (int)value;
+        int exponent = 63 - __builtin_clzll(value);
+        int sub = (int)(value >> (exponent - cSubBucketBits)) & ((1 << cSubBucketBits) - 1);
+        return ((exponent - cSubBucketBits + 1) << cSubBucketBits) + sub;
+    }
+
+    uint64_t Histogram::GetUpperBound(int index)
+    {
+        if(index < (1 << cSubBucketBits))
+            return (uint64_t)index;
+        int exponent = (index >> cSubBucketBits) + cSubBucketBits - 1;
+        uint64_t sub = (uint64_t)(index & ((1 << cSubBucketBits) - 1));
+        uint64_t lower = ((1ull << cSubBucketBits) + sub) << (exponent - cSubBucketBits);
+        return lower + (1ull << (exponent - cSubBucketBits)) - 1;
+    }
+
+    void Histogram::Record(uint64_t value)
+    {
+        counts[GetIndex(value)].fetch_add(1,std::memory_order_relaxed);
+        count.fetch_add(1,std::memory_order_relaxed);
+        sum.fetch_add(value,std::memory_order_relaxed);
+        auto currMax = max.load(std::memory_order_relaxed);
+        while(value > currMax && !max.compare_exchange_weak(currMax,value,std::memory_order_relaxed));
+    }
+
+    void Histogram::Reset()
+    {
+        for(auto & c : counts)
+            c.store(0,std::memory_order_relaxed);
+        count.store(0,std::memory_order_relaxed);
+        sum.store(0,std::memory_order_relaxed);
+        max.store(0,std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetCount() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetSum() const
+    {
+        return sum.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetMax() const
+    {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetPercentile(double fraction) const
+    {
+        auto total = GetCount();
+        if(total == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(fraction*total);
+        if(rank >= total)
+            rank = total - 1;
+        uint64_t cumulative = 0;
+        for(int i = 0; i < cBucketCount; ++i)
+        {
+            cumulative += counts[i].load(std::memory_order_relaxed);
+            if(cumulative > rank)
+                return std::min(GetUpperBound(i),GetMax());
+        }
+        return GetMax();
+    }
+
+    // Tracing
+
+    std::atomic<bool> enabled(false);
+
+    namespace
+    {
+        // Stamps of frames that are in flight.
+        // Entry is selected by frame ID, so frames are kept
+        // for cEntryCount periods before being overwritten.
+        struct Entry
+        {
+            std::atomic<uint32_t> frameId;
+            std::atomic<uint64_t> time[PointCount];
+        };
+
+        const int cEntryCount = 256;
+
+        const char * cPointNames[PointCount] = { "read", "process", "publish", "consume", "send" };
+
+        std::unique_ptr<Entry[]> entries;
+        std::unique_ptr<Histogram[]> histograms;    // [from*PointCount+to]
+
+        uint64_t Now()
+        {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    void Enable()
+    {
+        if(IsEnabled())
+            return;
+        entries.reset(new Entry[cEntryCount]);
+        for(int i = 0; i < cEntryCount; ++i)
+        {
+            entries[i].frameId.store(0,std::memory_order_relaxed);
+            for(auto & t : entries[i].time)
+                t.store(0,std::memory_order_relaxed);
+        }
+        histograms.reset(new Histogram[PointCount*PointCount]);
+        enabled.store(true);
+        Log("Trace: Per-frame latency tracing enabled.");
+    }
+
+    void StampNow(Point point, uint32_t frameId)
+    {
+        auto now = Now();
+        auto & entry = entries[frameId % cEntryCount];
+
+        if(point == PointRead)
+        {
+            entry.frameId.store(frameId,std::memory_order_relaxed);
+            for(int i = PointRead+1; i < PointCount; ++i)
+                entry.time[i].store(0,std::memory_order_relaxed);
+            entry.time[PointRead].store(now,std::memory_order_release);
+            return;
+        }
+
+        if(entry.frameId.load(std::memory_order_acquire) != frameId)
+            return;
+
+        // Only first stamp at each point counts (e.g. frame replicated in many packets).
+        uint64_t expected = 0;
+        if(!entry.time[point].compare_exchange_strong(expected,now,std::memory_order_acq_rel))
+            return;
+
+        // Latency from the most recent stamped point (some points are skipped by some pipelines).
+        int from = point-1;
+        for(; from >= PointRead; --from)
+        {
+            auto fromTime = entry.time[from].load(std::memory_order_acquire);
+            if(fromTime != 0 && fromTime <= now)
+            {
+                histograms[from*PointCount+point].Record(now - fromTime);
+                break;
+            }
+        }
+
+        // End-to-end latency
+        if(point == PointCount-1 && from > PointRead)
+        {
+            auto readTime = entry.time[PointRead].load(std::memory_order_acquire);
+            if(readTime != 0 && readTime <= now)
+                histograms[PointRead*PointCount+point].Record(now - readTime);
+        }
+    }
+
+    Histogram const& GetHistogram(Point from, Point to)
+    {
+        static Histogram empty;
+        if(!histograms)
+            return empty;
+        return histograms[from*PointCount+to];
+    }
+
+    char const* GetPointName(Point point)
+    {
+        return cPointNames[point];
+    }
+
+    void Dump()
+    {
+        if(!IsEnabled())
+            return;
+
+        Log("Trace: Latency between pipeline points [us]:");
+        for(int from = PointRead; from < PointCount; ++from)
+            for(int to = from+1; to < PointCount; ++to)
+            {
+                auto const& hist = histograms[from*PointCount+to];
+                if(hist.GetCount() == 0)
+                    continue;
+                { LogF() << "Trace:   " << std::setw(7) << cPointNames[from] << " -> " << std::setw(7) << std::left << cPointNames[to] << std::right
+                         << std::fixed << std::setprecision(1)
+                         << " count: " << hist.GetCount()
+                         << " p50: " << hist.GetPercentile(0.5)/1000.0
+                         << " p90: " << hist.GetPercentile(0.9)/1000.0
+                         << " p99: " << hist.GetPercentile(0.99)/1000.0
+                         << " p99.9: " << hist.GetPercentile(0.999)/1000.0
+                         << " max: " << hist.GetMax()/1000.0; }
+            }
+    }
+}